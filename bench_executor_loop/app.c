@@ -0,0 +1,161 @@
+#include <rcl/rcl.h>
+#include <rcl/error_handling.h>
+#include <rclc/rclc.h>
+#include <rclc/executor.h>
+
+#include <std_msgs/msg/header.h>
+
+#include <stdio.h>
+#include <unistd.h>
+#include <time.h>
+
+#ifdef ESP_PLATFORM
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#endif
+
+#include "../common/latency_histogram.h"
+#include "../common/executor_loop.h"
+
+// Before/after benchmark for the shared executor loop.
+//
+// A timer publishes a stamped Header every BENCH_PUBLISH_PERIOD_MS and the
+// same node subscribes to it through the agent. Each phase runs for
+// BENCH_PHASE_MS and reports delivered messages per second and the
+// publish-to-callback latency:
+//   - poll:  rclc_executor_spin_some(100 ms) + usleep(100 ms), the old app loop
+//   - block: executor_loop_spin_once(), the shared blocking loop
+
+#define BENCH_PUBLISH_PERIOD_MS 5
+#define BENCH_PHASE_MS 20000
+#define BENCH_POLL_SLEEP_MS 100
+
+#define RCCHECK(fn) { rcl_ret_t temp_rc = fn; if((temp_rc != RCL_RET_OK)){printf("Failed status on line %d: %d. Aborting.\n",__LINE__,(int)temp_rc); vTaskDelete(NULL);}}
+#define RCSOFTCHECK(fn) { rcl_ret_t temp_rc = fn; if((temp_rc != RCL_RET_OK)){printf("Failed status on line %d: %d. Continuing.\n",__LINE__,(int)temp_rc);}}
+
+rcl_publisher_t publisher;
+rcl_subscription_t subscriber;
+
+std_msgs__msg__Header outcoming_msg;
+std_msgs__msg__Header incoming_msg;
+char outcoming_buffer[1];
+char incoming_buffer[8];
+
+latency_histogram_t latency_histogram;
+uint32_t sent_count;
+
+int64_t monotonic_us(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+void timer_callback(rcl_timer_t * timer, int64_t last_call_time)
+{
+	RCLC_UNUSED(last_call_time);
+
+	if (timer != NULL) {
+		int64_t now = monotonic_us();
+		outcoming_msg.stamp.sec = (int32_t)(now / 1000000);
+		outcoming_msg.stamp.nanosec = (uint32_t)(now % 1000000) * 1000;
+		RCSOFTCHECK(rcl_publish(&publisher, &outcoming_msg, NULL));
+		sent_count++;
+	}
+}
+
+void subscription_callback(const void * msgin)
+{
+	const std_msgs__msg__Header * msg = (const std_msgs__msg__Header *)msgin;
+
+	int64_t sent = (int64_t)msg->stamp.sec * 1000000 + msg->stamp.nanosec / 1000;
+	int64_t latency = monotonic_us() - sent;
+	if (latency >= 0) {
+		latency_histogram_record(&latency_histogram, (uint32_t)latency);
+	}
+}
+
+void report_phase(const char * name, int64_t elapsed_us)
+{
+	double seconds = (double)elapsed_us / 1000000.0;
+
+	printf("%-6s sent %6u (%7.1f msg/s) received %6u (%7.1f msg/s) latency us: p50 %u p90 %u p99 %u max %u\n",
+		name,
+		(unsigned int)sent_count, sent_count / seconds,
+		(unsigned int)latency_histogram.total, latency_histogram.total / seconds,
+		(unsigned int)latency_histogram_percentile(&latency_histogram, 500),
+		(unsigned int)latency_histogram_percentile(&latency_histogram, 900),
+		(unsigned int)latency_histogram_percentile(&latency_histogram, 990),
+		(unsigned int)latency_histogram.max);
+}
+
+void run_phase(rclc_executor_t * executor, bool blocking)
+{
+	latency_histogram_reset(&latency_histogram);
+	sent_count = 0;
+
+	int64_t start = monotonic_us();
+	while(monotonic_us() - start < (int64_t)BENCH_PHASE_MS * 1000){
+		if (blocking) {
+			executor_loop_spin_once(executor, NULL);
+		} else {
+			rclc_executor_spin_some(executor, RCL_MS_TO_NS(BENCH_POLL_SLEEP_MS));
+			usleep(BENCH_POLL_SLEEP_MS * 1000);
+		}
+	}
+
+	report_phase(blocking ? "block" : "poll", monotonic_us() - start);
+}
+
+void appMain(void * arg)
+{
+	rcl_allocator_t allocator = rcl_get_default_allocator();
+	rclc_support_t support;
+
+	// create init_options
+	RCCHECK(rclc_support_init(&support, 0, NULL, &allocator));
+
+	// create node
+	rcl_node_t node;
+	RCCHECK(rclc_node_init_default(&node, "bench_executor_loop", "", &support));
+
+	// create publisher and a subscriber on the same topic
+	RCCHECK(rclc_publisher_init_default(&publisher, &node,
+		ROSIDL_GET_MSG_TYPE_SUPPORT(std_msgs, msg, Header), "/microROS/bench_executor_loop"));
+	RCCHECK(rclc_subscription_init_default(&subscriber, &node,
+		ROSIDL_GET_MSG_TYPE_SUPPORT(std_msgs, msg, Header), "/microROS/bench_executor_loop"));
+
+	// create publish timer
+	rcl_timer_t timer;
+	RCCHECK(rclc_timer_init_default(&timer, &support, RCL_MS_TO_NS(BENCH_PUBLISH_PERIOD_MS), timer_callback));
+
+	// create executor
+	rclc_executor_t executor = rclc_executor_get_zero_initialized_executor();
+	RCCHECK(rclc_executor_init(&executor, &support.context, 2, &allocator));
+	RCCHECK(rclc_executor_add_timer(&executor, &timer));
+	RCCHECK(rclc_executor_add_subscription(&executor, &subscriber, &incoming_msg, &subscription_callback, ON_NEW_DATA));
+
+	// The frame_id stays empty, the benchmark only needs the stamp
+	outcoming_buffer[0] = '\0';
+	outcoming_msg.frame_id.data = outcoming_buffer;
+	outcoming_msg.frame_id.size = 0;
+	outcoming_msg.frame_id.capacity = sizeof(outcoming_buffer);
+
+	incoming_msg.frame_id.data = incoming_buffer;
+	incoming_msg.frame_id.size = 0;
+	incoming_msg.frame_id.capacity = sizeof(incoming_buffer);
+
+	printf("Publishing every %d ms, %d s per phase\n", BENCH_PUBLISH_PERIOD_MS, BENCH_PHASE_MS / 1000);
+
+	while(1){
+		run_phase(&executor, false);
+		run_phase(&executor, true);
+	}
+
+	// free resources
+	RCCHECK(rcl_subscription_fini(&subscriber, &node));
+	RCCHECK(rcl_publisher_fini(&publisher, &node));
+	RCCHECK(rcl_node_fini(&node));
+
+	vTaskDelete(NULL);
+}
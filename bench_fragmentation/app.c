@@ -0,0 +1,221 @@
+#include <rcl/rcl.h>
+#include <rcl/error_handling.h>
+#include <rclc/rclc.h>
+#include <rclc/executor.h>
+
+#include <std_msgs/msg/u_int8_multi_array.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#ifdef ESP_PLATFORM
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#endif
+
+#include "../common/latency_histogram.h"
+#include "../common/executor_loop.h"
+#include "../common/xrce_fragments.h"
+
+// Fragmentation benchmark: message size sweep across the MTU boundaries.
+//
+// The node publishes UInt8MultiArray messages on a reliable topic and
+// subscribes to them through the agent, one message in flight at a time.
+// The serialized sizes are picked BENCH_SIZE_STEP bytes below and above
+// every size where one more fragment is needed, from unfragmented up to one
+// fragment more than the BENCH_STREAM_HISTORY slots of the reliable
+// streams hold, so the last step shows the cliff where messages can no
+// longer be reassembled. For every size it reports:
+//   - fragments per message
+//   - messages sent, received, and dropped (no echo within BENCH_TIMEOUT_MS)
+//   - publish failures
+//   - received messages and payload bytes per second
+//   - publish-to-callback latency percentiles
+// BENCH_TRANSPORT_MTU and BENCH_STREAM_HISTORY have to match the micro-ROS
+// client build and app-colcon.meta; rebuild with other values to move the
+// cliff.
+
+#ifndef BENCH_TRANSPORT_MTU
+#define BENCH_TRANSPORT_MTU 512
+#endif
+#define BENCH_STREAM_HISTORY 4
+#define BENCH_MESSAGES 200
+#define BENCH_TIMEOUT_MS 200
+#define BENCH_SIZE_STEP 16
+#define BENCH_MAX_SIZES (2 * (BENCH_STREAM_HISTORY + 1) + 1)
+
+// CDR payload size: empty layout.dim (4), data_offset (4), element count (4), then the bytes
+#define BENCH_CDR_OVERHEAD 12
+#define BENCH_MAX_DATA ((BENCH_STREAM_HISTORY + 1) * BENCH_TRANSPORT_MTU)
+
+// Sequence number and send time, at the start of every message
+#define BENCH_HEADER_BYTES 12
+
+#define RCCHECK(fn) { rcl_ret_t temp_rc = fn; if((temp_rc != RCL_RET_OK)){printf("Failed status on line %d: %d. Aborting.\n",__LINE__,(int)temp_rc); vTaskDelete(NULL);}}
+#define RCSOFTCHECK(fn) { rcl_ret_t temp_rc = fn; if((temp_rc != RCL_RET_OK)){printf("Failed status on line %d: %d. Continuing.\n",__LINE__,(int)temp_rc);}}
+
+rcl_publisher_t publisher;
+rcl_subscription_t subscriber;
+
+std_msgs__msg__UInt8MultiArray outcoming_msg;
+std_msgs__msg__UInt8MultiArray incoming_msg;
+uint8_t outcoming_data[BENCH_MAX_DATA];
+uint8_t incoming_data[BENCH_MAX_DATA];
+
+uint32_t expected_seq;
+uint32_t received;
+bool echoed;
+
+latency_histogram_t latency_histogram;
+
+int64_t monotonic_us(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+void subscription_callback(const void * msgin)
+{
+	const std_msgs__msg__UInt8MultiArray * msg = (const std_msgs__msg__UInt8MultiArray *)msgin;
+	uint32_t seq;
+	int64_t sent;
+
+	if (msg->data.size < BENCH_HEADER_BYTES) {
+		return;
+	}
+	memcpy(&seq, &msg->data.data[0], sizeof(seq));
+	memcpy(&sent, &msg->data.data[4], sizeof(sent));
+
+	// Late echoes of timed out messages are not counted
+	if (seq == expected_seq && !echoed) {
+		latency_histogram_record(&latency_histogram, (uint32_t)(monotonic_us() - sent));
+		received++;
+		echoed = true;
+	}
+}
+
+void run_size(rclc_executor_t * executor, size_t serialized)
+{
+	size_t data_size = serialized - BENCH_CDR_OVERHEAD;
+	uint32_t sent = 0;
+	uint32_t publish_errors = 0;
+
+	latency_histogram_reset(&latency_histogram);
+	received = 0;
+	outcoming_msg.data.size = data_size;
+
+	int64_t start = monotonic_us();
+	for (uint32_t i = 0; i < BENCH_MESSAGES; i++) {
+		int64_t now = monotonic_us();
+		expected_seq = i;
+		echoed = false;
+		memcpy(&outcoming_data[0], &i, sizeof(i));
+		memcpy(&outcoming_data[4], &now, sizeof(now));
+
+		if (rcl_publish(&publisher, &outcoming_msg, NULL) != RCL_RET_OK) {
+			publish_errors++;
+			continue;
+		}
+		sent++;
+
+		while(!echoed && monotonic_us() - now < (int64_t)BENCH_TIMEOUT_MS * 1000){
+			executor_loop_spin_once(executor, NULL);
+		}
+	}
+	double seconds = (double)(monotonic_us() - start) / 1000000.0;
+
+	printf("%5u bytes %u fragments: sent %4u (%u failed) received %4u dropped %4u  %7.1f msg/s %8.1f B/s  latency us: p50 %u p99 %u max %u\n",
+		(unsigned int)serialized, (unsigned int)xrce_fragments_count(serialized, BENCH_TRANSPORT_MTU),
+		(unsigned int)sent, (unsigned int)publish_errors,
+		(unsigned int)received, (unsigned int)(sent - received),
+		received / seconds, received * (double)data_size / seconds,
+		(unsigned int)latency_histogram_percentile(&latency_histogram, 500),
+		(unsigned int)latency_histogram_percentile(&latency_histogram, 990),
+		(unsigned int)latency_histogram.max);
+}
+
+// Serialized sizes around every fragment boundary, ascending
+size_t bench_sizes(size_t * sizes)
+{
+	size_t count = 0;
+
+	sizes[count++] = 64;
+	for (size_t fragments = 1; fragments <= BENCH_STREAM_HISTORY + 1; fragments++) {
+		size_t boundary = xrce_fragments_max_payload(BENCH_TRANSPORT_MTU, fragments);
+		if (boundary - BENCH_SIZE_STEP > sizes[count - 1]) {
+			sizes[count++] = boundary - BENCH_SIZE_STEP;
+		}
+		if (boundary + BENCH_SIZE_STEP - BENCH_CDR_OVERHEAD <= BENCH_MAX_DATA) {
+			sizes[count++] = boundary + BENCH_SIZE_STEP;
+		}
+	}
+	return count;
+}
+
+void appMain(void * arg)
+{
+	rcl_allocator_t allocator = rcl_get_default_allocator();
+	rclc_support_t support;
+
+	// create init_options
+	RCCHECK(rclc_support_init(&support, 0, NULL, &allocator));
+
+	// create node
+	rcl_node_t node;
+	RCCHECK(rclc_node_init_default(&node, "bench_fragmentation", "", &support));
+
+	// reliable publisher and subscriber, best effort streams do not fragment
+	const rosidl_message_type_support_t * type_support = ROSIDL_GET_MSG_TYPE_SUPPORT(std_msgs, msg, UInt8MultiArray);
+	RCCHECK(rclc_publisher_init_default(&publisher, &node, type_support, "/microROS/bench_fragmentation"));
+	RCCHECK(rclc_subscription_init_default(&subscriber, &node, type_support, "/microROS/bench_fragmentation"));
+
+	// create executor
+	rclc_executor_t executor = rclc_executor_get_zero_initialized_executor();
+	RCCHECK(rclc_executor_init(&executor, &support.context, 1, &allocator));
+	RCCHECK(rclc_executor_add_subscription(&executor, &subscriber, &incoming_msg, &subscription_callback, ON_NEW_DATA));
+
+	// Fill the message memory statically
+	outcoming_msg.layout.dim.data = NULL;
+	outcoming_msg.layout.dim.size = 0;
+	outcoming_msg.layout.dim.capacity = 0;
+	outcoming_msg.layout.data_offset = 0;
+	outcoming_msg.data.data = outcoming_data;
+	outcoming_msg.data.size = 0;
+	outcoming_msg.data.capacity = BENCH_MAX_DATA;
+	for (size_t i = 0; i < BENCH_MAX_DATA; i++) {
+		outcoming_data[i] = (uint8_t)i;
+	}
+
+	incoming_msg.layout.dim.data = NULL;
+	incoming_msg.layout.dim.size = 0;
+	incoming_msg.layout.dim.capacity = 0;
+	incoming_msg.layout.data_offset = 0;
+	incoming_msg.data.data = incoming_data;
+	incoming_msg.data.size = 0;
+	incoming_msg.data.capacity = BENCH_MAX_DATA;
+
+	size_t sizes[BENCH_MAX_SIZES];
+	size_t size_count = bench_sizes(sizes);
+
+	printf("MTU %d, stream history %d: up to %u bytes unfragmented, %u reassembled. %d messages per size\n",
+		BENCH_TRANSPORT_MTU, BENCH_STREAM_HISTORY,
+		(unsigned int)xrce_fragments_single_capacity(BENCH_TRANSPORT_MTU),
+		(unsigned int)xrce_fragments_max_payload(BENCH_TRANSPORT_MTU, BENCH_STREAM_HISTORY),
+		BENCH_MESSAGES);
+
+	while(1){
+		for (size_t i = 0; i < size_count; i++) {
+			run_size(&executor, sizes[i]);
+		}
+	}
+
+	// free resources
+	RCCHECK(rcl_subscription_fini(&subscriber, &node));
+	RCCHECK(rcl_publisher_fini(&publisher, &node));
+	RCCHECK(rcl_node_fini(&node));
+
+	vTaskDelete(NULL);
+}
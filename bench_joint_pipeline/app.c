@@ -0,0 +1,3 @@
+// ESP32 build of benchmarks/bench_joint_pipeline.c, which provides appMain()
+// when ESP_PLATFORM is defined. Needs no agent.
+#include "../benchmarks/bench_joint_pipeline.c"
@@ -0,0 +1,212 @@
+#include <rcl/rcl.h>
+#include <rcl/error_handling.h>
+#include <rclc/rclc.h>
+#include <rclc/executor.h>
+
+#include <std_msgs/msg/header.h>
+#include <std_msgs/msg/u_int8_multi_array.h>
+
+#include <stdio.h>
+#include <unistd.h>
+#include <time.h>
+
+#ifdef ESP_PLATFORM
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#endif
+
+#include "../common/latency_histogram.h"
+#include "../common/executor_loop.h"
+#include "../common/stream_class.h"
+
+// Control latency under a saturated telemetry channel.
+//
+// A control timer publishes a stamped Header every BENCH_CONTROL_PERIOD_MS
+// on the reliable stream and the same node subscribes to it through the
+// agent. Meanwhile a telemetry timer publishes BENCH_TELEMETRY_BURST
+// messages of BENCH_TELEMETRY_BYTES every BENCH_TELEMETRY_PERIOD_MS, more
+// than the link comfortably carries. Each phase runs for BENCH_PHASE_MS
+// and reports the control publish time and publish-to-callback latency:
+//   - shared:    telemetry created as STREAM_CLASS_CONTROL, on the reliable
+//                stream next to the commands (the old default QoS)
+//   - separated: telemetry created as STREAM_CLASS_TELEMETRY, on the
+//                best-effort stream
+
+#define BENCH_CONTROL_PERIOD_MS 50
+#define BENCH_TELEMETRY_PERIOD_MS 10
+#define BENCH_TELEMETRY_BURST 4
+#define BENCH_TELEMETRY_BYTES 200
+#define BENCH_PHASE_MS 20000
+
+#define RCCHECK(fn) { rcl_ret_t temp_rc = fn; if((temp_rc != RCL_RET_OK)){printf("Failed status on line %d: %d. Aborting.\n",__LINE__,(int)temp_rc); vTaskDelete(NULL);}}
+#define RCSOFTCHECK(fn) { rcl_ret_t temp_rc = fn; if((temp_rc != RCL_RET_OK)){printf("Failed status on line %d: %d. Continuing.\n",__LINE__,(int)temp_rc);}}
+
+rcl_publisher_t control_publisher;
+rcl_subscription_t control_subscriber;
+rcl_publisher_t telemetry_publishers[2];
+rcl_publisher_t * telemetry_publisher;
+
+std_msgs__msg__Header outcoming_control;
+std_msgs__msg__Header incoming_control;
+char outcoming_buffer[1];
+char incoming_buffer[8];
+
+std_msgs__msg__UInt8MultiArray telemetry_msg;
+uint8_t telemetry_buffer[BENCH_TELEMETRY_BYTES];
+
+latency_histogram_t latency_histogram;
+latency_histogram_t publish_histogram;
+uint32_t control_sent;
+uint32_t telemetry_sent;
+uint32_t telemetry_errors;
+
+int64_t monotonic_us(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+void control_timer_callback(rcl_timer_t * timer, int64_t last_call_time)
+{
+	RCLC_UNUSED(last_call_time);
+
+	if (timer != NULL) {
+		int64_t now = monotonic_us();
+		outcoming_control.stamp.sec = (int32_t)(now / 1000000);
+		outcoming_control.stamp.nanosec = (uint32_t)(now % 1000000) * 1000;
+		RCSOFTCHECK(rcl_publish(&control_publisher, &outcoming_control, NULL));
+		latency_histogram_record(&publish_histogram, (uint32_t)(monotonic_us() - now));
+		control_sent++;
+	}
+}
+
+void telemetry_timer_callback(rcl_timer_t * timer, int64_t last_call_time)
+{
+	RCLC_UNUSED(last_call_time);
+
+	if (timer != NULL && telemetry_publisher != NULL) {
+		for (int i = 0; i < BENCH_TELEMETRY_BURST; i++) {
+			telemetry_buffer[0]++;
+			if (rcl_publish(telemetry_publisher, &telemetry_msg, NULL) == RCL_RET_OK) {
+				telemetry_sent++;
+			} else {
+				telemetry_errors++;
+			}
+		}
+	}
+}
+
+void control_callback(const void * msgin)
+{
+	const std_msgs__msg__Header * msg = (const std_msgs__msg__Header *)msgin;
+	int64_t sent = (int64_t)msg->stamp.sec * 1000000 + msg->stamp.nanosec / 1000;
+	int64_t latency = monotonic_us() - sent;
+
+	if (latency >= 0) {
+		latency_histogram_record(&latency_histogram, (uint32_t)latency);
+	}
+}
+
+void run_phase(rclc_executor_t * executor, const char * name, rcl_publisher_t * publisher)
+{
+	latency_histogram_reset(&latency_histogram);
+	latency_histogram_reset(&publish_histogram);
+	control_sent = 0;
+	telemetry_sent = 0;
+	telemetry_errors = 0;
+	telemetry_publisher = publisher;
+
+	int64_t start = monotonic_us();
+	while(monotonic_us() - start < (int64_t)BENCH_PHASE_MS * 1000){
+		executor_loop_spin_once(executor, NULL);
+	}
+	telemetry_publisher = NULL;
+
+	double seconds = (double)(monotonic_us() - start) / 1000000.0;
+	printf("%-9s telemetry %7.1f msg/s (%u failed) control sent %u received %u publish us: p50 %u p99 %u max %u latency us: p50 %u p99 %u max %u\n",
+		name,
+		telemetry_sent / seconds, (unsigned int)telemetry_errors,
+		(unsigned int)control_sent, (unsigned int)latency_histogram.total,
+		(unsigned int)latency_histogram_percentile(&publish_histogram, 500),
+		(unsigned int)latency_histogram_percentile(&publish_histogram, 990),
+		(unsigned int)publish_histogram.max,
+		(unsigned int)latency_histogram_percentile(&latency_histogram, 500),
+		(unsigned int)latency_histogram_percentile(&latency_histogram, 990),
+		(unsigned int)latency_histogram.max);
+}
+
+void appMain(void * arg)
+{
+	rcl_allocator_t allocator = rcl_get_default_allocator();
+	rclc_support_t support;
+
+	// create init_options
+	RCCHECK(rclc_support_init(&support, 0, NULL, &allocator));
+
+	// create node
+	rcl_node_t node;
+	RCCHECK(rclc_node_init_default(&node, "bench_stream_classes", "", &support));
+
+	// control loop back through the agent
+	RCCHECK(stream_class_publisher_init(&control_publisher, &node,
+		ROSIDL_GET_MSG_TYPE_SUPPORT(std_msgs, msg, Header), "/microROS/bench_control", STREAM_CLASS_CONTROL));
+	RCCHECK(stream_class_subscription_init(&control_subscriber, &node,
+		ROSIDL_GET_MSG_TYPE_SUPPORT(std_msgs, msg, Header), "/microROS/bench_control", STREAM_CLASS_CONTROL));
+
+	// the same telemetry topic once per stream class
+	const rosidl_message_type_support_t * telemetry_type = ROSIDL_GET_MSG_TYPE_SUPPORT(std_msgs, msg, UInt8MultiArray);
+	RCCHECK(stream_class_publisher_init(&telemetry_publishers[0], &node,
+		telemetry_type, "/microROS/bench_telemetry_shared", STREAM_CLASS_CONTROL));
+	RCCHECK(stream_class_publisher_init(&telemetry_publishers[1], &node,
+		telemetry_type, "/microROS/bench_telemetry_separated", STREAM_CLASS_TELEMETRY));
+
+	// create timers
+	rcl_timer_t control_timer;
+	RCCHECK(rclc_timer_init_default(&control_timer, &support, RCL_MS_TO_NS(BENCH_CONTROL_PERIOD_MS), control_timer_callback));
+	rcl_timer_t telemetry_timer;
+	RCCHECK(rclc_timer_init_default(&telemetry_timer, &support, RCL_MS_TO_NS(BENCH_TELEMETRY_PERIOD_MS), telemetry_timer_callback));
+
+	// create executor
+	rclc_executor_t executor = rclc_executor_get_zero_initialized_executor();
+	RCCHECK(rclc_executor_init(&executor, &support.context, 3, &allocator));
+	RCCHECK(rclc_executor_add_timer(&executor, &control_timer));
+	RCCHECK(rclc_executor_add_timer(&executor, &telemetry_timer));
+	RCCHECK(rclc_executor_add_subscription(&executor, &control_subscriber, &incoming_control, &control_callback, ON_NEW_DATA));
+
+	// Fill the message memory statically
+	outcoming_control.frame_id.data = outcoming_buffer;
+	outcoming_control.frame_id.data[0] = '\0';
+	outcoming_control.frame_id.size = 0;
+	outcoming_control.frame_id.capacity = sizeof(outcoming_buffer);
+
+	incoming_control.frame_id.data = incoming_buffer;
+	incoming_control.frame_id.size = 0;
+	incoming_control.frame_id.capacity = sizeof(incoming_buffer);
+
+	telemetry_msg.layout.dim.data = NULL;
+	telemetry_msg.layout.dim.size = 0;
+	telemetry_msg.layout.dim.capacity = 0;
+	telemetry_msg.layout.data_offset = 0;
+	telemetry_msg.data.data = telemetry_buffer;
+	telemetry_msg.data.size = BENCH_TELEMETRY_BYTES;
+	telemetry_msg.data.capacity = BENCH_TELEMETRY_BYTES;
+
+	printf("Control every %d ms, telemetry %d x %d bytes every %d ms, %d s per phase\n",
+		BENCH_CONTROL_PERIOD_MS, BENCH_TELEMETRY_BURST, BENCH_TELEMETRY_BYTES,
+		BENCH_TELEMETRY_PERIOD_MS, BENCH_PHASE_MS / 1000);
+
+	while(1){
+		run_phase(&executor, "shared", &telemetry_publishers[0]);
+		run_phase(&executor, "separated", &telemetry_publishers[1]);
+	}
+
+	// free resources
+	RCCHECK(rcl_publisher_fini(&telemetry_publishers[1], &node));
+	RCCHECK(rcl_publisher_fini(&telemetry_publishers[0], &node));
+	RCCHECK(rcl_subscription_fini(&control_subscriber, &node));
+	RCCHECK(rcl_publisher_fini(&control_publisher, &node));
+	RCCHECK(rcl_node_fini(&node));
+
+	vTaskDelete(NULL);
+}
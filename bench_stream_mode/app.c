@@ -0,0 +1,223 @@
+#include <rcl/rcl.h>
+#include <rcl/error_handling.h>
+#include <rclc/rclc.h>
+#include <rclc/executor.h>
+
+#include <geometry_msgs/msg/polygon_stamped.h>
+
+#include <stdio.h>
+#include <unistd.h>
+#include <time.h>
+
+#ifdef ESP_PLATFORM
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#endif
+
+#include "../common/latency_histogram.h"
+#include "../common/executor_loop.h"
+#include "../common/crazyflie_telemetry.h"
+
+// Reliable versus best-effort streaming benchmark for the telemetry frame.
+//
+// A timer publishes sequence-numbered telemetry frames every
+// BENCH_PUBLISH_PERIOD_MS and the same node subscribes to them through the
+// agent. Each phase runs for BENCH_PHASE_MS on one QoS and reports:
+//   - achieved send and receive rate
+//   - frames lost, from gaps in the sequence numbers
+//   - publish calls slower than BENCH_STALL_US (head-of-line stalls) and the slowest one
+//   - publish-to-callback latency percentiles
+// Run it against a lossy link (or an agent behind netem) to see the
+// reliable stream trade rate and latency for completeness.
+
+#define BENCH_PUBLISH_PERIOD_MS 10
+#define BENCH_PHASE_MS 20000
+#define BENCH_STALL_US 2000
+
+#define RCCHECK(fn) { rcl_ret_t temp_rc = fn; if((temp_rc != RCL_RET_OK)){printf("Failed status on line %d: %d. Aborting.\n",__LINE__,(int)temp_rc); vTaskDelete(NULL);}}
+#define RCSOFTCHECK(fn) { rcl_ret_t temp_rc = fn; if((temp_rc != RCL_RET_OK)){printf("Failed status on line %d: %d. Continuing.\n",__LINE__,(int)temp_rc);}}
+
+typedef struct bench_phase_t {
+	const char * name;
+	rcl_publisher_t publisher;
+	rcl_subscription_t subscriber;
+	uint32_t seq;
+	uint32_t sent;
+	uint32_t publish_errors;
+	uint32_t stalls;
+	uint32_t max_publish_us;
+	uint32_t received;
+	uint32_t lost;
+	uint32_t next_expected;
+	bool synced;
+} bench_phase_t;
+
+bench_phase_t phases[2];
+bench_phase_t * active_phase;
+
+crazyflie_telemetry_t outcoming_frame;
+geometry_msgs__msg__PolygonStamped incoming_frames[2];
+char incoming_frame_ids[2][CRAZYFLIE_TELEMETRY_SEQ_LEN + 1];
+geometry_msgs__msg__Point32 incoming_points[2][CRAZYFLIE_TELEMETRY_MAX_POINTS];
+
+latency_histogram_t latency_histogram;
+
+int64_t monotonic_us(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+void timer_callback(rcl_timer_t * timer, int64_t last_call_time)
+{
+	RCLC_UNUSED(last_call_time);
+
+	if (timer != NULL && active_phase != NULL) {
+		int64_t now = monotonic_us();
+		outcoming_frame.msg.header.stamp.sec = (int32_t)(now / 1000000);
+		outcoming_frame.msg.header.stamp.nanosec = (uint32_t)(now % 1000000) * 1000;
+		crazyflie_telemetry_set_seq(&outcoming_frame, active_phase->seq++);
+
+		rcl_ret_t rc = rcl_publish(&active_phase->publisher, &outcoming_frame.msg, NULL);
+		uint32_t elapsed = (uint32_t)(monotonic_us() - now);
+
+		if (rc == RCL_RET_OK) {
+			active_phase->sent++;
+		} else {
+			active_phase->publish_errors++;
+		}
+		if (elapsed > BENCH_STALL_US) {
+			active_phase->stalls++;
+		}
+		if (elapsed > active_phase->max_publish_us) {
+			active_phase->max_publish_us = elapsed;
+		}
+	}
+}
+
+void receive(bench_phase_t * phase, const geometry_msgs__msg__PolygonStamped * msg)
+{
+	uint32_t seq;
+	if (!crazyflie_telemetry_get_seq(msg, &seq)) {
+		return;
+	}
+
+	int64_t sent = (int64_t)msg->header.stamp.sec * 1000000 + msg->header.stamp.nanosec / 1000;
+	int64_t latency = monotonic_us() - sent;
+	if (latency >= 0 && phase == active_phase) {
+		latency_histogram_record(&latency_histogram, (uint32_t)latency);
+	}
+
+	// Frames are counted lost once a later sequence number arrives
+	if (phase->synced && (int32_t)(seq - phase->next_expected) > 0) {
+		phase->lost += seq - phase->next_expected;
+	}
+	if (!phase->synced || (int32_t)(seq - phase->next_expected) >= 0) {
+		phase->next_expected = seq + 1;
+	}
+	phase->synced = true;
+	phase->received++;
+}
+
+void reliable_callback(const void * msgin)
+{
+	receive(&phases[0], (const geometry_msgs__msg__PolygonStamped *)msgin);
+}
+
+void best_effort_callback(const void * msgin)
+{
+	receive(&phases[1], (const geometry_msgs__msg__PolygonStamped *)msgin);
+}
+
+void run_phase(rclc_executor_t * executor, bench_phase_t * phase)
+{
+	latency_histogram_reset(&latency_histogram);
+	phase->sent = 0;
+	phase->publish_errors = 0;
+	phase->stalls = 0;
+	phase->max_publish_us = 0;
+	phase->received = 0;
+	phase->lost = 0;
+	phase->synced = false;
+	active_phase = phase;
+
+	int64_t start = monotonic_us();
+	while(monotonic_us() - start < (int64_t)BENCH_PHASE_MS * 1000){
+		executor_loop_spin_once(executor, NULL);
+	}
+	active_phase = NULL;
+
+	double seconds = (double)(monotonic_us() - start) / 1000000.0;
+	printf("%-11s sent %6u (%6.1f/s, %u failed) received %6u (%6.1f/s) lost %u stalls %u (max publish %u us) latency us: p50 %u p99 %u max %u\n",
+		phase->name,
+		(unsigned int)phase->sent, phase->sent / seconds, (unsigned int)phase->publish_errors,
+		(unsigned int)phase->received, phase->received / seconds,
+		(unsigned int)phase->lost, (unsigned int)phase->stalls, (unsigned int)phase->max_publish_us,
+		(unsigned int)latency_histogram_percentile(&latency_histogram, 500),
+		(unsigned int)latency_histogram_percentile(&latency_histogram, 990),
+		(unsigned int)latency_histogram.max);
+}
+
+void appMain(void * arg)
+{
+	rcl_allocator_t allocator = rcl_get_default_allocator();
+	rclc_support_t support;
+
+	// create init_options
+	RCCHECK(rclc_support_init(&support, 0, NULL, &allocator));
+
+	// create node
+	rcl_node_t node;
+	RCCHECK(rclc_node_init_default(&node, "bench_stream_mode", "", &support));
+
+	// one publisher/subscriber pair per QoS
+	const rosidl_message_type_support_t * type_support = ROSIDL_GET_MSG_TYPE_SUPPORT(geometry_msgs, msg, PolygonStamped);
+	phases[0].name = "reliable";
+	RCCHECK(rclc_publisher_init_default(&phases[0].publisher, &node, type_support, "/microROS/bench_stream_reliable"));
+	RCCHECK(rclc_subscription_init_default(&phases[0].subscriber, &node, type_support, "/microROS/bench_stream_reliable"));
+	phases[1].name = "best-effort";
+	RCCHECK(rclc_publisher_init_best_effort(&phases[1].publisher, &node, type_support, "/microROS/bench_stream_best_effort"));
+	RCCHECK(rclc_subscription_init_best_effort(&phases[1].subscriber, &node, type_support, "/microROS/bench_stream_best_effort"));
+
+	// create publish timer
+	rcl_timer_t timer;
+	RCCHECK(rclc_timer_init_default(&timer, &support, RCL_MS_TO_NS(BENCH_PUBLISH_PERIOD_MS), timer_callback));
+
+	// create executor
+	rclc_executor_t executor = rclc_executor_get_zero_initialized_executor();
+	RCCHECK(rclc_executor_init(&executor, &support.context, 3, &allocator));
+	RCCHECK(rclc_executor_add_timer(&executor, &timer));
+	RCCHECK(rclc_executor_add_subscription(&executor, &phases[0].subscriber, &incoming_frames[0], &reliable_callback, ON_NEW_DATA));
+	RCCHECK(rclc_executor_add_subscription(&executor, &phases[1].subscriber, &incoming_frames[1], &best_effort_callback, ON_NEW_DATA));
+
+	// Fill the message memory statically
+	crazyflie_telemetry_init(&outcoming_frame);
+	crazyflie_telemetry_set_attitude(&outcoming_frame, 1.0f, 2.0f, 3.0f);
+	crazyflie_telemetry_set_position(&outcoming_frame, 0.1f, 0.2f, 0.3f);
+
+	for (int i = 0; i < 2; i++) {
+		incoming_frames[i].header.frame_id.data = incoming_frame_ids[i];
+		incoming_frames[i].header.frame_id.size = 0;
+		incoming_frames[i].header.frame_id.capacity = sizeof(incoming_frame_ids[i]);
+		incoming_frames[i].polygon.points.data = incoming_points[i];
+		incoming_frames[i].polygon.points.size = 0;
+		incoming_frames[i].polygon.points.capacity = CRAZYFLIE_TELEMETRY_MAX_POINTS;
+	}
+
+	printf("Publishing every %d ms, %d s per phase\n", BENCH_PUBLISH_PERIOD_MS, BENCH_PHASE_MS / 1000);
+
+	while(1){
+		run_phase(&executor, &phases[0]);
+		run_phase(&executor, &phases[1]);
+	}
+
+	// free resources
+	for (int i = 0; i < 2; i++) {
+		RCCHECK(rcl_subscription_fini(&phases[i].subscriber, &node));
+		RCCHECK(rcl_publisher_fini(&phases[i].publisher, &node));
+	}
+	RCCHECK(rcl_node_fini(&node));
+
+	vTaskDelete(NULL);
+}
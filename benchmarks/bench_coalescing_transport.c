@@ -0,0 +1,159 @@
+// Host-side benchmark: write-coalescing transport against direct writes.
+//
+// Build: cc -O2 -pthread -o bench_coalescing_transport bench_coalescing_transport.c
+// Usage: ./bench_coalescing_transport [message_bytes] [per_write_us] [messages]
+//
+// Stands in for the radio with a pipe drained by a second thread. Every
+// write() on it optionally busy-waits per_write_us to model the fixed
+// per-packet cost of the link. The same stream of framed messages is sent
+// once with one write per message and once through coalescing_transport.h
+// in bursts of BURST messages followed by a read, as rmw_microxrcedds
+// does when it publishes and then services the session. Both runs report
+// write calls and throughput.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "../common/coalescing_transport.h"
+
+#define BURST 4
+
+static int pipe_fds[2];
+static uint32_t per_write_us;
+static uint32_t backend_writes;
+
+static uint64_t now_us(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static bool pipe_open(struct uxrCustomTransport * transport)
+{
+	(void)transport;
+	return true;
+}
+
+static bool pipe_close(struct uxrCustomTransport * transport)
+{
+	(void)transport;
+	return true;
+}
+
+static size_t pipe_write(struct uxrCustomTransport * transport, const uint8_t * buf, size_t len, uint8_t * errcode)
+{
+	(void)transport;
+	backend_writes++;
+
+	if (per_write_us > 0) {
+		uint64_t until = now_us() + per_write_us;
+		while (now_us() < until) {
+		}
+	}
+
+	ssize_t written = write(pipe_fds[1], buf, len);
+	if (written < 0) {
+		*errcode = 1;
+		return 0;
+	}
+	*errcode = 0;
+	return (size_t)written;
+}
+
+// No replies on this link, a read only has to flush
+static size_t pipe_read(struct uxrCustomTransport * transport, uint8_t * buf, size_t len, int timeout, uint8_t * errcode)
+{
+	(void)transport;
+	(void)buf;
+	(void)len;
+	(void)timeout;
+	*errcode = 0;
+	return 0;
+}
+
+static void * drain(void * arg)
+{
+	uint64_t * received = (uint64_t *)arg;
+	uint8_t buf[4096];
+	ssize_t n;
+
+	while ((n = read(pipe_fds[0], buf, sizeof(buf))) > 0) {
+		*received += (uint64_t)n;
+	}
+	return NULL;
+}
+
+static void run(const char * name, bool coalesce, size_t message_bytes, uint32_t messages)
+{
+	uint8_t message[COALESCING_TRANSPORT_MTU];
+	uint64_t received = 0;
+	pthread_t reader;
+	uint8_t errcode;
+
+	if (pipe(pipe_fds) != 0) {
+		perror("pipe");
+		exit(1);
+	}
+	pthread_create(&reader, NULL, drain, &received);
+
+	memset(message, 0x7E, sizeof(message));
+	backend_writes = 0;
+	coalescing_transport_install(pipe_open, pipe_close, pipe_write, pipe_read, 0, 0);
+
+	uint64_t start = now_us();
+	for (uint32_t i = 0; i < messages; i++) {
+		if (coalesce) {
+			coalescing_transport_write(NULL, message, message_bytes, &errcode);
+		} else {
+			pipe_write(NULL, message, message_bytes, &errcode);
+		}
+		if (coalesce && (i + 1) % BURST == 0) {
+			coalescing_transport_read(NULL, NULL, 0, 0, &errcode);
+		}
+	}
+	if (coalesce) {
+		coalescing_transport_flush();
+	}
+	close(pipe_fds[1]);
+	pthread_join(reader, NULL);
+	uint64_t elapsed = now_us() - start;
+	close(pipe_fds[0]);
+
+	printf("%-9s %8u writes %10.0f msg/s %8.2f MB/s (%llu bytes)\n",
+		name, (unsigned int)backend_writes,
+		messages * 1e6 / (double)elapsed,
+		(double)received / (double)elapsed,
+		(unsigned long long)received);
+}
+
+int main(int argc, char ** argv)
+{
+	size_t message_bytes = (argc > 1) ? (size_t)atoi(argv[1]) : 24;
+	per_write_us = (argc > 2) ? (uint32_t)atoi(argv[2]) : 0;
+	uint32_t messages = (argc > 3) ? (uint32_t)atoi(argv[3]) : 200000;
+
+	if (message_bytes == 0 || message_bytes > COALESCING_TRANSPORT_MTU) {
+		fprintf(stderr, "message_bytes must be 1..%d\n", COALESCING_TRANSPORT_MTU);
+		return 1;
+	}
+
+	printf("%u messages of %u bytes, bursts of %d, %u us per write, %d byte buffer\n",
+		(unsigned int)messages, (unsigned int)message_bytes, BURST,
+		(unsigned int)per_write_us, COALESCING_TRANSPORT_MTU);
+
+	run("direct", false, message_bytes, messages);
+	run("coalesced", true, message_bytes, messages);
+
+	coalescing_transport_stats_t stats = coalescing_transport_get_stats();
+	printf("coalesced: %u messages -> %u writes (%u threshold, %u deadline, %u read, %u explicit flushes, %u errors)\n",
+		(unsigned int)stats.messages, (unsigned int)stats.writes,
+		(unsigned int)stats.threshold_flushes, (unsigned int)stats.deadline_flushes,
+		(unsigned int)stats.read_flushes, (unsigned int)stats.explicit_flushes,
+		(unsigned int)stats.errors);
+	return 0;
+}
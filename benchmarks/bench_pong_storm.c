@@ -0,0 +1,137 @@
+// Host-side benchmark: messages per ping on a shared link as the ping_pong
+// fleet grows, answering every ping (PONG_MODE_ALWAYS) versus randomized
+// backoff with cancellation (PONG_MODE_BACKOFF).
+//
+// Build: cc -O2 -o bench_pong_storm bench_pong_storm.c
+// Usage: ./bench_pong_storm [tx_ms] [backoff_max_ms] [quorum]
+//
+// The model is one broadcast medium shared by all devices. Every message
+// occupies it for tx_ms, a device only hears a pong once that transmission
+// has completed, and each ping is simulated in isolation with 1 ms steps.
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../common/pong_suppressor.h"
+
+#define MAX_NODES 128
+#define PINGS_PER_SIZE 200
+
+typedef struct ping_result_t {
+	uint32_t messages;
+	uint32_t pongs_heard;
+	int64_t first_pong_ms;
+	int64_t last_message_ms;
+} ping_result_t;
+
+static pong_suppressor_t nodes[MAX_NODES];
+
+static ping_result_t simulate_ping(int fleet, int mode, uint32_t quorum, uint32_t backoff_max_ms, int64_t tx_ms)
+{
+	ping_result_t result = {1, 0, -1, tx_ms};
+	const uint32_t pinger = 0;
+	const uint32_t seq = (uint32_t)rand();
+
+	// In-flight pong transmissions, each one delivered to everybody when it ends
+	int64_t deliveries[MAX_NODES];
+	int delivery_count = 0;
+	int64_t link_busy_until = tx_ms;
+
+	for (int i = 0; i < fleet; i++) {
+		pong_suppressor_init(&nodes[i], mode, quorum, backoff_max_ms);
+	}
+
+	// The ping reaches every peer when its own transmission ends
+	int pending = 0;
+	for (int i = 1; i < fleet; i++) {
+		if (pong_suppressor_on_ping(&nodes[i], pinger, seq, 0, 0, tx_ms * 1000)) {
+			int64_t start = (link_busy_until > tx_ms) ? link_busy_until : tx_ms;
+			link_busy_until = start + tx_ms;
+			deliveries[delivery_count++] = link_busy_until;
+		} else {
+			pending++;
+		}
+	}
+
+	for (int64_t now = tx_ms; pending > 0 || delivery_count > 0; now++) {
+		// Deliver the pongs whose transmission finished by now
+		for (int d = 0; d < delivery_count; ) {
+			if (deliveries[d] <= now) {
+				result.pongs_heard++;
+				result.messages++;
+				if (result.first_pong_ms < 0) {
+					result.first_pong_ms = deliveries[d];
+				}
+				if (deliveries[d] > result.last_message_ms) {
+					result.last_message_ms = deliveries[d];
+				}
+				for (int i = 1; i < fleet; i++) {
+					pong_suppressor_on_pong(&nodes[i], pinger, seq);
+				}
+				deliveries[d] = deliveries[--delivery_count];
+			} else {
+				d++;
+			}
+		}
+
+		// Send the pongs whose backoff expired and were not cancelled
+		pending = 0;
+		for (int i = 1; i < fleet; i++) {
+			if (pong_suppressor_next_due(&nodes[i], now * 1000) != NULL) {
+				int64_t start = (link_busy_until > now) ? link_busy_until : now;
+				link_busy_until = start + tx_ms;
+				deliveries[delivery_count++] = link_busy_until;
+			}
+			for (unsigned int p = 0; p < PONG_PENDING_MAX; p++) {
+				pending += nodes[i].pending[p].active;
+			}
+		}
+	}
+
+	return result;
+}
+
+static void run_mode(const char * name, int mode, uint32_t quorum, uint32_t backoff_max_ms, int64_t tx_ms)
+{
+	static const int fleets[] = {2, 4, 8, 12, 16, 24, 32, 64, 128};
+
+	printf("\n%s\n", name);
+	printf("%6s %14s %16s %14s %16s %16s\n",
+		"nodes", "msgs/ping", "msgs/round", "pongs heard", "first pong ms", "link busy ms");
+
+	for (unsigned int f = 0; f < sizeof(fleets) / sizeof(fleets[0]); f++) {
+		int fleet = fleets[f];
+		double messages = 0, heard = 0, first = 0, busy = 0;
+
+		for (int p = 0; p < PINGS_PER_SIZE; p++) {
+			ping_result_t r = simulate_ping(fleet, mode, quorum, backoff_max_ms, tx_ms);
+			messages += r.messages;
+			heard += r.pongs_heard;
+			first += (r.first_pong_ms >= 0) ? r.first_pong_ms : 0;
+			busy += r.last_message_ms;
+		}
+
+		messages /= PINGS_PER_SIZE;
+		printf("%6d %14.2f %16.1f %14.2f %16.1f %16.1f\n",
+			fleet, messages, messages * fleet, heard / PINGS_PER_SIZE,
+			first / PINGS_PER_SIZE, busy / PINGS_PER_SIZE);
+	}
+}
+
+int main(int argc, char ** argv)
+{
+	int64_t tx_ms = (argc > 1) ? atoi(argv[1]) : 2;
+	uint32_t backoff_max_ms = (argc > 2) ? (uint32_t)atoi(argv[2]) : 200;
+	uint32_t quorum = (argc > 3) ? (uint32_t)atoi(argv[3]) : 1;
+
+	srand(1234);
+
+	printf("Shared link: %d ms per message, backoff up to %u ms, quorum %u\n",
+		(int)tx_ms, (unsigned int)backoff_max_ms, (unsigned int)quorum);
+	printf("msgs/round assumes every node pings once per round\n");
+
+	run_mode("PONG_MODE_ALWAYS", PONG_MODE_ALWAYS, quorum, backoff_max_ms, tx_ms);
+	run_mode("PONG_MODE_BACKOFF", PONG_MODE_BACKOFF, quorum, backoff_max_ms, tx_ms);
+
+	return 0;
+}
@@ -0,0 +1,242 @@
+#ifndef COALESCING_TRANSPORT_H_
+#define COALESCING_TRANSPORT_H_
+
+// Write-coalescing adapter for micro-ROS custom transports.
+//
+// With framing enabled, Micro XRCE-DDS passes every serialized message to
+// the transport's write function as soon as it is framed, in one or more
+// small writes, so each one costs at least one radio packet. This adapter
+// sits between rmw_uros_set_custom_transport() and the real transport and
+// appends the framed messages to a buffer of COALESCING_TRANSPORT_MTU
+// bytes instead. The buffer goes out in one write to the real transport
+// when:
+//   - the next message would push it past the fill threshold
+//   - it holds data older than the deadline when another message arrives
+//     or coalescing_transport_poll() is called
+//   - XRCE reads from the transport, so requests are out before their replies are awaited
+//   - the application calls coalescing_transport_flush(), e.g. at the end of a loop cycle
+// No timer runs in the background: a message written last, with no write or
+// read after it, waits past the deadline until the application polls or
+// flushes. Every rcl_wait() of an executor reads, so spinning apps are
+// covered; others call coalescing_transport_poll() from their periodic work.
+// The serial framing delimits every message itself, so the agent parses
+// the concatenated stream unchanged. This only works with framing on.
+//
+// The adapter keeps one set of state and wraps one transport, so it can
+// only serve one session:
+//   coalescing_transport_install(crazyflie_serial_open, crazyflie_serial_close,
+//       crazyflie_serial_write, crazyflie_serial_read, 2000, 0);
+//   rmw_uros_set_custom_transport(true, args, coalescing_transport_open,
+//       coalescing_transport_close, coalescing_transport_write, coalescing_transport_read);
+//
+// Timestamps come from COALESCING_TRANSPORT_NOW_US(), with the same
+// defaults as periodic_runner.h; define it before including this header
+// to use another clock.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include <time.h>
+
+#ifndef COALESCING_TRANSPORT_MTU
+#define COALESCING_TRANSPORT_MTU 256
+#endif
+
+#ifndef COALESCING_TRANSPORT_NOW_US
+#if defined(ESP_PLATFORM)
+#include "esp_timer.h"
+#define COALESCING_TRANSPORT_NOW_US() ((uint64_t)esp_timer_get_time())
+#elif defined(INC_FREERTOS_H)
+#define COALESCING_TRANSPORT_NOW_US() ((uint64_t)xTaskGetTickCount() * portTICK_PERIOD_MS * 1000)
+#else
+static inline uint64_t coalescing_transport_monotonic_us(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+#define COALESCING_TRANSPORT_NOW_US() coalescing_transport_monotonic_us()
+#endif
+#endif
+
+struct uxrCustomTransport;
+
+typedef bool (*coalescing_transport_open_t)(struct uxrCustomTransport * transport);
+typedef bool (*coalescing_transport_close_t)(struct uxrCustomTransport * transport);
+typedef size_t (*coalescing_transport_write_t)(struct uxrCustomTransport * transport,
+	const uint8_t * buf, size_t len, uint8_t * errcode);
+typedef size_t (*coalescing_transport_read_t)(struct uxrCustomTransport * transport,
+	uint8_t * buf, size_t len, int timeout, uint8_t * errcode);
+
+typedef struct coalescing_transport_stats_t {
+	uint32_t messages;          // writes issued by XRCE
+	uint32_t writes;            // writes passed to the real transport
+	uint32_t bytes;
+	uint32_t threshold_flushes;
+	uint32_t deadline_flushes;
+	uint32_t read_flushes;
+	uint32_t explicit_flushes;
+	uint32_t errors;            // short writes, the unwritten rest is dropped
+} coalescing_transport_stats_t;
+
+typedef struct coalescing_transport_t {
+	coalescing_transport_open_t open;
+	coalescing_transport_close_t close;
+	coalescing_transport_write_t write;
+	coalescing_transport_read_t read;
+	struct uxrCustomTransport * transport;
+	uint8_t buffer[COALESCING_TRANSPORT_MTU];
+	size_t length;
+	size_t threshold;
+	uint32_t deadline_us;
+	uint64_t oldest_us;
+	coalescing_transport_stats_t stats;
+} coalescing_transport_t;
+
+static coalescing_transport_t coalescing_transport;
+
+// Wraps the real transport. 'deadline_us' bounds how long a message may wait
+// for company (0: until the buffer fills or is flushed), 'threshold' is the
+// fill level that triggers a flush (0: the whole buffer).
+static inline void coalescing_transport_install(coalescing_transport_open_t open, coalescing_transport_close_t close,
+	coalescing_transport_write_t write, coalescing_transport_read_t read, uint32_t deadline_us, size_t threshold)
+{
+	coalescing_transport.open = open;
+	coalescing_transport.close = close;
+	coalescing_transport.write = write;
+	coalescing_transport.read = read;
+	coalescing_transport.transport = NULL;
+	coalescing_transport.length = 0;
+	coalescing_transport.threshold = (threshold == 0 || threshold > COALESCING_TRANSPORT_MTU) ?
+		COALESCING_TRANSPORT_MTU : threshold;
+	coalescing_transport.deadline_us = deadline_us;
+	memset(&coalescing_transport.stats, 0, sizeof(coalescing_transport.stats));
+}
+
+static inline coalescing_transport_stats_t coalescing_transport_get_stats(void)
+{
+	return coalescing_transport.stats;
+}
+
+static inline bool coalescing_transport_send(struct uxrCustomTransport * transport, const uint8_t * buf, size_t len)
+{
+	uint8_t errcode = 0;
+	size_t sent = 0;
+
+	while (sent < len) {
+		size_t written = coalescing_transport.write(transport, buf + sent, len - sent, &errcode);
+		coalescing_transport.stats.writes++;
+		if (written == 0 || errcode != 0) {
+			coalescing_transport.stats.errors++;
+			return false;
+		}
+		sent += written;
+	}
+	coalescing_transport.stats.bytes += (uint32_t)sent;
+	return true;
+}
+
+static inline bool coalescing_transport_drain(void)
+{
+	if (coalescing_transport.length == 0) {
+		return true;
+	}
+
+	bool ok = coalescing_transport_send(coalescing_transport.transport,
+		coalescing_transport.buffer, coalescing_transport.length);
+	coalescing_transport.length = 0;
+	return ok;
+}
+
+// Sends whatever is buffered now
+static inline bool coalescing_transport_flush(void)
+{
+	if (coalescing_transport.length > 0) {
+		coalescing_transport.stats.explicit_flushes++;
+	}
+	return coalescing_transport_drain();
+}
+
+// Sends the buffer if it holds data older than the deadline; cheap enough to
+// call from every cycle of a periodic task
+static inline bool coalescing_transport_poll(void)
+{
+	if (coalescing_transport.length == 0 || coalescing_transport.deadline_us == 0 ||
+		COALESCING_TRANSPORT_NOW_US() - coalescing_transport.oldest_us < coalescing_transport.deadline_us) {
+		return true;
+	}
+	coalescing_transport.stats.deadline_flushes++;
+	return coalescing_transport_drain();
+}
+
+static inline bool coalescing_transport_open(struct uxrCustomTransport * transport)
+{
+	coalescing_transport.transport = transport;
+	coalescing_transport.length = 0;
+	return coalescing_transport.open(transport);
+}
+
+static inline bool coalescing_transport_close(struct uxrCustomTransport * transport)
+{
+	coalescing_transport_drain();
+	return coalescing_transport.close(transport);
+}
+
+static inline size_t coalescing_transport_write(struct uxrCustomTransport * transport,
+	const uint8_t * buf, size_t len, uint8_t * errcode)
+{
+	uint64_t now = COALESCING_TRANSPORT_NOW_US();
+
+	coalescing_transport.transport = transport;
+	coalescing_transport.stats.messages++;
+
+	// A failed drain loses the buffered messages, so this write fails too
+	if (coalescing_transport.length > 0) {
+		bool drained = true;
+		if (coalescing_transport.length + len > coalescing_transport.threshold) {
+			coalescing_transport.stats.threshold_flushes++;
+			drained = coalescing_transport_drain();
+		} else if (coalescing_transport.deadline_us > 0 &&
+			now - coalescing_transport.oldest_us >= coalescing_transport.deadline_us) {
+			coalescing_transport.stats.deadline_flushes++;
+			drained = coalescing_transport_drain();
+		}
+		if (!drained) {
+			*errcode = 1;
+			return 0;
+		}
+	}
+
+	// Larger than the whole buffer: nothing to gain, pass it through
+	if (len > coalescing_transport.threshold) {
+		if (!coalescing_transport_send(transport, buf, len)) {
+			*errcode = 1;
+			return 0;
+		}
+		return len;
+	}
+
+	if (coalescing_transport.length == 0) {
+		coalescing_transport.oldest_us = now;
+	}
+	memcpy(&coalescing_transport.buffer[coalescing_transport.length], buf, len);
+	coalescing_transport.length += len;
+	*errcode = 0;
+	return len;
+}
+
+static inline size_t coalescing_transport_read(struct uxrCustomTransport * transport,
+	uint8_t * buf, size_t len, int timeout, uint8_t * errcode)
+{
+	if (coalescing_transport.length > 0) {
+		coalescing_transport.stats.read_flushes++;
+		if (!coalescing_transport_drain()) {
+			*errcode = 1;
+			return 0;
+		}
+	}
+	return coalescing_transport.read(transport, buf, len, timeout, errcode);
+}
+
+#endif /* COALESCING_TRANSPORT_H_ */
@@ -0,0 +1,100 @@
+#ifndef CRAZYFLIE_LOG_SNAPSHOT_H_
+#define CRAZYFLIE_LOG_SNAPSHOT_H_
+
+// Batched reads of Crazyflie log variables.
+//
+// Variables are resolved once with logGetVarId() when they are added to a
+// snapshot group. log_snapshot_read() then copies all of them into one
+// contiguous float array with the scheduler suspended. The estimator runs
+// in its own task, so it cannot run halfway through the copy and every
+// value in a snapshot comes from the same estimator cycle.
+//
+// log_snapshot_add_pose() registers the stateEstimate attitude and position
+// in the pitch, roll, yaw, x, y, z order used by the telemetry frame.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "log.h"
+
+#ifndef LOG_SNAPSHOT_MAX_VARS
+#define LOG_SNAPSHOT_MAX_VARS 8
+#endif
+
+typedef struct log_snapshot_t {
+	int ids[LOG_SNAPSHOT_MAX_VARS];
+	size_t count;
+	uint32_t reads;
+} log_snapshot_t;
+
+// Output layout of log_snapshot_add_pose(), matches crazyflie_telemetry_pose_values()
+typedef struct crazyflie_pose_t {
+	float pitch;
+	float roll;
+	float yaw;
+	float x;
+	float y;
+	float z;
+} crazyflie_pose_t;
+
+static inline void log_snapshot_init(log_snapshot_t * snapshot)
+{
+	snapshot->count = 0;
+	snapshot->reads = 0;
+}
+
+// Resolves 'group.name' and appends it; false if the group is full or the variable is unknown
+static inline bool log_snapshot_add(log_snapshot_t * snapshot, const char * group, const char * name)
+{
+	if (snapshot->count >= LOG_SNAPSHOT_MAX_VARS) {
+		return false;
+	}
+
+	int id = logGetVarId((char *)group, (char *)name);
+	if (id < 0) {
+		return false;
+	}
+
+	snapshot->ids[snapshot->count++] = id;
+	return true;
+}
+
+static inline bool log_snapshot_add_pose(log_snapshot_t * snapshot)
+{
+	return log_snapshot_add(snapshot, "stateEstimate", "pitch") &&
+		log_snapshot_add(snapshot, "stateEstimate", "roll") &&
+		log_snapshot_add(snapshot, "stateEstimate", "yaw") &&
+		log_snapshot_add(snapshot, "stateEstimate", "x") &&
+		log_snapshot_add(snapshot, "stateEstimate", "y") &&
+		log_snapshot_add(snapshot, "stateEstimate", "z");
+}
+
+// Copies every registered variable into 'values' (count floats) in one pass
+static inline void log_snapshot_read(log_snapshot_t * snapshot, float * values)
+{
+	vTaskSuspendAll();
+	for (size_t i = 0; i < snapshot->count; i++) {
+		values[i] = logGetFloat(snapshot->ids[i]);
+	}
+	xTaskResumeAll();
+
+	snapshot->reads++;
+}
+
+static inline void log_snapshot_read_pose(log_snapshot_t * snapshot, crazyflie_pose_t * pose)
+{
+	float values[LOG_SNAPSHOT_MAX_VARS] = {0};
+	log_snapshot_read(snapshot, values);
+
+	pose->pitch = values[0];
+	pose->roll = values[1];
+	pose->yaw = values[2];
+	pose->x = values[3];
+	pose->y = values[4];
+	pose->z = values[5];
+}
+
+#endif /* CRAZYFLIE_LOG_SNAPSHOT_H_ */
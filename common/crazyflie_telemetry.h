@@ -0,0 +1,151 @@
+#ifndef CRAZYFLIE_TELEMETRY_H_
+#define CRAZYFLIE_TELEMETRY_H_
+
+// Coalesced Crazyflie telemetry frame.
+//
+// Attitude, position and the optional weather station values travel as one
+// geometry_msgs/PolygonStamped instead of one Point32 message each, so a
+// sample pays for a single XRCE header on the radio and every vector in it
+// is read in the same loop iteration. Point layout:
+//   points[0]  attitude (pitch, roll, yaw)
+//   points[1]  position (x, y, z)
+//   points[2]  temperature, humidity, 0 - only present when a sample is attached
+// header.stamp holds the time the frame was sampled. frame_id is empty, or
+// carries the frame sequence number as 8 hex digits in streaming mode so the
+// receiver can count lost frames.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include <geometry_msgs/msg/polygon_stamped.h>
+
+#define CRAZYFLIE_TELEMETRY_TOPIC "/drone/telemetry"
+
+#define CRAZYFLIE_TELEMETRY_ATTITUDE 0
+#define CRAZYFLIE_TELEMETRY_POSITION 1
+#define CRAZYFLIE_TELEMETRY_WEATHER 2
+#define CRAZYFLIE_TELEMETRY_MAX_POINTS 3
+#define CRAZYFLIE_TELEMETRY_SEQ_LEN 8
+
+typedef struct crazyflie_telemetry_t {
+	geometry_msgs__msg__PolygonStamped msg;
+	geometry_msgs__msg__Point32 points[CRAZYFLIE_TELEMETRY_MAX_POINTS];
+	char frame_id[CRAZYFLIE_TELEMETRY_SEQ_LEN + 1];
+} crazyflie_telemetry_t;
+
+// Points the message sequences at the frame's own storage, no allocation
+static inline void crazyflie_telemetry_init(crazyflie_telemetry_t * frame)
+{
+	for (int i = 0; i < CRAZYFLIE_TELEMETRY_MAX_POINTS; i++) {
+		frame->points[i].x = 0.0f;
+		frame->points[i].y = 0.0f;
+		frame->points[i].z = 0.0f;
+	}
+
+	frame->frame_id[0] = '\0';
+	frame->msg.header.frame_id.data = frame->frame_id;
+	frame->msg.header.frame_id.size = 0;
+	frame->msg.header.frame_id.capacity = sizeof(frame->frame_id);
+	frame->msg.header.stamp.sec = 0;
+	frame->msg.header.stamp.nanosec = 0;
+
+	frame->msg.polygon.points.data = frame->points;
+	frame->msg.polygon.points.size = CRAZYFLIE_TELEMETRY_WEATHER;
+	frame->msg.polygon.points.capacity = CRAZYFLIE_TELEMETRY_MAX_POINTS;
+}
+
+static inline void crazyflie_telemetry_stamp(crazyflie_telemetry_t * frame, uint32_t time_ms)
+{
+	frame->msg.header.stamp.sec = (int32_t)(time_ms / 1000);
+	frame->msg.header.stamp.nanosec = (time_ms % 1000) * 1000000u;
+}
+
+static inline void crazyflie_telemetry_set_attitude(crazyflie_telemetry_t * frame, float pitch, float roll, float yaw)
+{
+	frame->points[CRAZYFLIE_TELEMETRY_ATTITUDE].x = pitch;
+	frame->points[CRAZYFLIE_TELEMETRY_ATTITUDE].y = roll;
+	frame->points[CRAZYFLIE_TELEMETRY_ATTITUDE].z = yaw;
+}
+
+static inline void crazyflie_telemetry_set_position(crazyflie_telemetry_t * frame, float x, float y, float z)
+{
+	frame->points[CRAZYFLIE_TELEMETRY_POSITION].x = x;
+	frame->points[CRAZYFLIE_TELEMETRY_POSITION].y = y;
+	frame->points[CRAZYFLIE_TELEMETRY_POSITION].z = z;
+}
+
+// Attaches a weather sample to the next published frame
+static inline void crazyflie_telemetry_set_weather(crazyflie_telemetry_t * frame, float temperature, float humidity)
+{
+	frame->points[CRAZYFLIE_TELEMETRY_WEATHER].x = temperature;
+	frame->points[CRAZYFLIE_TELEMETRY_WEATHER].y = humidity;
+	frame->points[CRAZYFLIE_TELEMETRY_WEATHER].z = 0.0f;
+	frame->msg.polygon.points.size = CRAZYFLIE_TELEMETRY_MAX_POINTS;
+}
+
+static inline bool crazyflie_telemetry_has_weather(const crazyflie_telemetry_t * frame)
+{
+	return frame->msg.polygon.points.size > CRAZYFLIE_TELEMETRY_WEATHER;
+}
+
+// Drops the weather point once it has been sent, so every sample goes out once
+static inline void crazyflie_telemetry_clear_weather(crazyflie_telemetry_t * frame)
+{
+	frame->msg.polygon.points.size = CRAZYFLIE_TELEMETRY_WEATHER;
+}
+
+// Stamps 'seq' into frame_id
+static inline void crazyflie_telemetry_set_seq(crazyflie_telemetry_t * frame, uint32_t seq)
+{
+	static const char digits[] = "0123456789abcdef";
+	for (int i = CRAZYFLIE_TELEMETRY_SEQ_LEN - 1; i >= 0; i--) {
+		frame->frame_id[i] = digits[seq & 0xF];
+		seq >>= 4;
+	}
+	frame->frame_id[CRAZYFLIE_TELEMETRY_SEQ_LEN] = '\0';
+	frame->msg.header.frame_id.size = CRAZYFLIE_TELEMETRY_SEQ_LEN;
+}
+
+// Reads the sequence number back from a received frame, false if it carries none
+static inline bool crazyflie_telemetry_get_seq(const geometry_msgs__msg__PolygonStamped * msg, uint32_t * seq)
+{
+	if (msg->header.frame_id.size != CRAZYFLIE_TELEMETRY_SEQ_LEN) {
+		return false;
+	}
+
+	uint32_t value = 0;
+	for (size_t i = 0; i < CRAZYFLIE_TELEMETRY_SEQ_LEN; i++) {
+		char c = msg->header.frame_id.data[i];
+		uint32_t digit;
+		if (c >= '0' && c <= '9') {
+			digit = (uint32_t)(c - '0');
+		} else if (c >= 'a' && c <= 'f') {
+			digit = (uint32_t)(c - 'a' + 10);
+		} else {
+			return false;
+		}
+		value = (value << 4) | digit;
+	}
+	*seq = value;
+	return true;
+}
+
+// Copies attitude and position into 'values' as pitch, roll, yaw, x, y, z
+static inline void crazyflie_telemetry_pose_values(const crazyflie_telemetry_t * frame, float values[6])
+{
+	for (int i = 0; i < 2; i++) {
+		values[3 * i + 0] = frame->points[i].x;
+		values[3 * i + 1] = frame->points[i].y;
+		values[3 * i + 2] = frame->points[i].z;
+	}
+}
+
+// CDR payload size: stamp (8), frame_id (4 + length + 1, padded to 4), point count (4), 12 bytes per point
+static inline size_t crazyflie_telemetry_serialized_size(const crazyflie_telemetry_t * frame)
+{
+	size_t frame_id = (4 + frame->msg.header.frame_id.size + 1 + 3) & ~(size_t)3;
+	return 8 + frame_id + 4 + 12 * frame->msg.polygon.points.size;
+}
+
+#endif /* CRAZYFLIE_TELEMETRY_H_ */
@@ -0,0 +1,63 @@
+#ifndef EXECUTOR_LOOP_H_
+#define EXECUTOR_LOOP_H_
+
+// Shared blocking run loop for the rclc apps.
+//
+// rclc_executor_spin_some() already blocks in rcl_wait() until a handle is
+// ready, and rcl_wait() shortens the timeout to the next timer deadline.
+// The apps used to follow every spin with usleep(), which added up to one
+// sleep period of latency to every message and capped each handle at one
+// sample per period. This loop just keeps waiting, so it wakes on transport
+// readiness or on the next timer deadline and never sleeps on top of that.
+
+#include <stdint.h>
+#include <unistd.h>
+
+#include <rcl/rcl.h>
+#include <rclc/executor.h>
+
+// Upper bound for a single wait when nothing is ready and no timer is due
+#ifndef EXECUTOR_LOOP_WAIT_MS
+#define EXECUTOR_LOOP_WAIT_MS 1000
+#endif
+
+// Pause after a failed spin (e.g. an empty wait set) so errors do not busy-loop
+#ifndef EXECUTOR_LOOP_ERROR_BACKOFF_MS
+#define EXECUTOR_LOOP_ERROR_BACKOFF_MS 100
+#endif
+
+typedef struct executor_loop_stats_t {
+	uint32_t wakeups;
+	uint32_t idle;
+	uint32_t errors;
+} executor_loop_stats_t;
+
+static inline rcl_ret_t executor_loop_spin_once(rclc_executor_t * executor, executor_loop_stats_t * stats)
+{
+	rcl_ret_t rc = rclc_executor_spin_some(executor, RCL_MS_TO_NS(EXECUTOR_LOOP_WAIT_MS));
+
+	if (stats != NULL) {
+		stats->wakeups++;
+		if (rc == RCL_RET_TIMEOUT) {
+			stats->idle++;
+		} else if (rc != RCL_RET_OK) {
+			stats->errors++;
+		}
+	}
+
+	if (rc != RCL_RET_OK && rc != RCL_RET_TIMEOUT) {
+		usleep(EXECUTOR_LOOP_ERROR_BACKOFF_MS * 1000);
+	}
+
+	return rc;
+}
+
+// Runs the executor forever; 'stats' may be NULL
+static inline void executor_loop_run(rclc_executor_t * executor, executor_loop_stats_t * stats)
+{
+	while(1){
+		executor_loop_spin_once(executor, stats);
+	}
+}
+
+#endif /* EXECUTOR_LOOP_H_ */
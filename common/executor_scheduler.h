@@ -0,0 +1,524 @@
+#ifndef EXECUTOR_SCHEDULER_H_
+#define EXECUTOR_SCHEDULER_H_
+
+// Priority-based scheduler for several rclc executors.
+//
+// Spinning several executors in turn from one loop couples them: a long
+// callback of one executor delays every other one, whatever their urgency.
+// The scheduler runs the callbacks of every executor in a worker task at
+// the executor's own priority, a FreeRTOS task or a SCHED_FIFO thread on
+// POSIX, so the kernel runs the most urgent executor that has work and
+// preempts less urgent callbacks for it.
+//
+// All executors share one XRCE session, and a wait holds the session lock
+// for as long as it waits. Only one task therefore waits on the session:
+// the dispatcher, which runs above every worker. Each round it polls every
+// idle executor with a zero timeout, most urgent first, and hands an
+// executor whose trigger accepts its work to the worker. The wrapped
+// trigger returns false in the dispatcher, so nothing is taken there; the
+// worker takes the data from the rmw buffers and runs the callbacks. Then:
+//   - while a worker has work, the dispatcher leaves the session to the
+//     workers and only polls again when one is done, after
+//     EXECUTOR_SCHEDULER_POLL_MS or at the next timer of an idle executor
+//   - otherwise it waits on the session for at most EXECUTOR_SCHEDULER_WAIT_MS,
+//     cut short at the next timer of any executor, and any data arriving
+//     ends the wait for all of them
+// Callbacks still take the session lock to publish, so the client has to be
+// built with -DUCLIENT_PROFILE_MULTITHREAD=ON (microxrcedds_client in the
+// app's colcon meta).
+//
+// Data a trigger does not accept yet (e.g. one of two subscriptions under
+// rclc_executor_trigger_all) stays in the rmw buffers and ends every wait
+// at once. When a wait ends early and nothing is handed over, the
+// dispatcher pauses EXECUTOR_SCHEDULER_POLL_MS before the next wait instead
+// of spinning above every worker.
+//
+// The response time of an executor is measured from the moment its work
+// became ready to the end of the callbacks that ran it, handoff and
+// preemption by more urgent executors included. A timer is ready at its
+// planned expiry (rcl_timer_get_time_until_next_call()), other handles when
+// the dispatcher sees their data. It goes into a latency histogram, and
+// responses longer than the executor's deadline count as misses. Set the
+// executor's trigger before executor_scheduler_add(), which wraps it.
+//
+// Timestamps come from EXECUTOR_SCHEDULER_NOW_US(), which defaults to
+// esp_timer_get_time() on ESP32, the tick count on other FreeRTOS ports
+// and CLOCK_MONOTONIC on POSIX.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <rcl/rcl.h>
+#include <rclc/executor.h>
+
+#ifndef INC_FREERTOS_H
+#include <pthread.h>
+#include <sched.h>
+#include <semaphore.h>
+#endif
+
+#include "latency_histogram.h"
+
+#ifndef EXECUTOR_SCHEDULER_NOW_US
+#if defined(ESP_PLATFORM)
+#include "esp_timer.h"
+#define EXECUTOR_SCHEDULER_NOW_US() ((uint64_t)esp_timer_get_time())
+#elif defined(INC_FREERTOS_H)
+#define EXECUTOR_SCHEDULER_NOW_US() ((uint64_t)xTaskGetTickCount() * portTICK_PERIOD_MS * 1000)
+#else
+static inline uint64_t executor_scheduler_monotonic_us(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+#define EXECUTOR_SCHEDULER_NOW_US() executor_scheduler_monotonic_us()
+#endif
+#endif
+
+#ifndef EXECUTOR_SCHEDULER_MAX_EXECUTORS
+#define EXECUTOR_SCHEDULER_MAX_EXECUTORS 4
+#endif
+
+// Longest single wait of the dispatcher
+#ifndef EXECUTOR_SCHEDULER_WAIT_MS
+#define EXECUTOR_SCHEDULER_WAIT_MS 10
+#endif
+
+// Poll period of the dispatcher while a worker has work, and its pause after
+// a wait that ended early without any work to hand over; at least one tick
+#ifndef EXECUTOR_SCHEDULER_POLL_MS
+#define EXECUTOR_SCHEDULER_POLL_MS 1
+#endif
+
+// An executor whose spin failed (e.g. an empty wait set) is left alone this long
+#ifndef EXECUTOR_SCHEDULER_ERROR_BACKOFF_MS
+#define EXECUTOR_SCHEDULER_ERROR_BACKOFF_MS 100
+#endif
+
+// Stack of every task: words on most FreeRTOS ports, bytes on ESP-IDF
+#ifndef EXECUTOR_SCHEDULER_STACK_SIZE
+#define EXECUTOR_SCHEDULER_STACK_SIZE 4096
+#endif
+
+struct executor_scheduler_t;
+
+typedef struct executor_scheduler_entry_t {
+	rclc_executor_t * executor;
+	const char * name;
+	int priority;
+	uint32_t deadline_us;       // 0: none
+	struct executor_scheduler_t * scheduler;
+	// Trigger of the executor, called by the wrapper
+	rclc_executor_trigger_t trigger;
+	void * trigger_object;
+	// Handoff: set by the dispatcher, cleared by the worker when done
+	volatile bool pending;
+	bool handed;
+	bool executed;
+	uint64_t ready_us;
+	uint64_t retry_us;
+#ifdef INC_FREERTOS_H
+	TaskHandle_t task;
+#else
+	pthread_t thread;
+	sem_t work;
+	bool realtime;              // running under SCHED_FIFO
+#endif
+	// Statistics
+	uint32_t dispatches;
+	uint32_t misses;
+	uint32_t errors;
+	latency_histogram_t response_us;
+} executor_scheduler_entry_t;
+
+typedef struct executor_scheduler_t {
+	executor_scheduler_entry_t entries[EXECUTOR_SCHEDULER_MAX_EXECUTORS];
+	executor_scheduler_entry_t * order[EXECUTOR_SCHEDULER_MAX_EXECUTORS];   // most urgent first
+	size_t count;
+	bool started;
+	bool idle;                  // the last wait ended early with nothing to hand over
+#ifdef INC_FREERTOS_H
+	TaskHandle_t dispatcher;
+#else
+	pthread_t dispatcher;
+	sem_t done;
+	bool realtime;
+#endif
+	// Statistics
+	uint32_t waits;
+	uint32_t idle_pauses;
+} executor_scheduler_t;
+
+static inline void executor_scheduler_init(executor_scheduler_t * scheduler)
+{
+	scheduler->count = 0;
+	scheduler->started = false;
+	scheduler->idle = false;
+	scheduler->waits = 0;
+	scheduler->idle_pauses = 0;
+}
+
+#ifdef INC_FREERTOS_H
+static inline TickType_t executor_scheduler_ticks(int64_t ns)
+{
+	TickType_t ticks = pdMS_TO_TICKS(ns / 1000000);
+	return (ticks > 0) ? ticks : 1;
+}
+#endif
+
+// Sleeps without holding the session; at least one tick on FreeRTOS, where
+// a shorter usleep() may busy-wait
+static inline void executor_scheduler_sleep(int64_t ns)
+{
+#ifdef INC_FREERTOS_H
+	vTaskDelay(executor_scheduler_ticks(ns));
+#else
+	usleep((useconds_t)(ns / 1000));
+#endif
+}
+
+// Earliest time the ready handles became ready: the planned expiry of an
+// overdue timer, now for anything else
+static inline uint64_t executor_scheduler_ready_us(const rclc_executor_handle_t * handles, unsigned int size)
+{
+	uint64_t now = EXECUTOR_SCHEDULER_NOW_US();
+	uint64_t ready = now;
+
+	for (unsigned int i = 0; i < size && handles[i].initialized; i++) {
+		int64_t until_next;
+		if (handles[i].data_available && handles[i].type == RCLC_TIMER &&
+			rcl_timer_get_time_until_next_call(handles[i].timer, &until_next) == RCL_RET_OK && until_next < 0) {
+			uint64_t overdue = (uint64_t)(-until_next) / 1000;
+			if (overdue < now && now - overdue < ready) {
+				ready = now - overdue;
+			}
+		}
+	}
+	return ready;
+}
+
+static inline bool executor_scheduler_trigger(rclc_executor_handle_t * handles, unsigned int size, void * obj)
+{
+	executor_scheduler_entry_t * entry = (executor_scheduler_entry_t *)obj;
+	bool ready = entry->trigger(handles, size, entry->trigger_object);
+
+	if (entry->pending) {
+		// Worker: take the data and run the callbacks
+		entry->executed = entry->executed || ready;
+		return ready;
+	}
+
+	// Dispatcher: note the work and leave the data for the worker
+	if (ready) {
+		entry->ready_us = executor_scheduler_ready_us(handles, size);
+		entry->handed = true;
+	}
+	return false;
+}
+
+// 'priority' is the FreeRTOS task priority, or the SCHED_FIFO priority on
+// POSIX; higher runs first. 'deadline_ms' may be 0. Returns NULL when full
+// or already started.
+static inline executor_scheduler_entry_t * executor_scheduler_add(executor_scheduler_t * scheduler,
+	rclc_executor_t * executor, const char * name, int priority, uint32_t deadline_ms)
+{
+	if (scheduler->started || scheduler->count >= EXECUTOR_SCHEDULER_MAX_EXECUTORS) {
+		return NULL;
+	}
+
+	executor_scheduler_entry_t * entry = &scheduler->entries[scheduler->count];
+	entry->executor = executor;
+	entry->name = name;
+	entry->priority = priority;
+	entry->deadline_us = deadline_ms * 1000;
+	entry->scheduler = scheduler;
+	entry->trigger = (executor->trigger_function != NULL) ? executor->trigger_function : rclc_executor_trigger_any;
+	entry->trigger_object = executor->trigger_object;
+	entry->pending = false;
+	entry->handed = false;
+	entry->executed = false;
+	entry->retry_us = 0;
+	entry->dispatches = 0;
+	entry->misses = 0;
+	entry->errors = 0;
+	latency_histogram_reset(&entry->response_us);
+
+	// Keep the order most urgent first
+	size_t i = scheduler->count++;
+	for (; i > 0 && scheduler->order[i - 1]->priority < priority; i--) {
+		scheduler->order[i] = scheduler->order[i - 1];
+	}
+	scheduler->order[i] = entry;
+
+	rclc_executor_set_trigger(executor, executor_scheduler_trigger, entry);
+	return entry;
+}
+
+static inline void executor_scheduler_failed(executor_scheduler_entry_t * entry, rcl_ret_t rc)
+{
+	if (rc != RCL_RET_OK && rc != RCL_RET_TIMEOUT) {
+		entry->errors++;
+		entry->retry_us = EXECUTOR_SCHEDULER_NOW_US() + EXECUTOR_SCHEDULER_ERROR_BACKOFF_MS * 1000;
+	}
+}
+
+// Dispatcher: spins the executor without running anything and hands its
+// work to the worker. Returns whether it did.
+static inline bool executor_scheduler_poll(executor_scheduler_entry_t * entry, int64_t timeout_ns)
+{
+	entry->handed = false;
+	executor_scheduler_failed(entry, rclc_executor_spin_some(entry->executor, timeout_ns));
+	if (!entry->handed) {
+		return false;
+	}
+
+	entry->pending = true;
+#ifdef INC_FREERTOS_H
+	xTaskNotifyGive(entry->task);
+#else
+	sem_post(&entry->work);
+#endif
+	return true;
+}
+
+// Time until the next timer of an idle executor is due, at most 'limit'.
+// Overdue timers do not count: the last poll saw them, and an idle executor
+// has a trigger that did not accept them.
+static inline int64_t executor_scheduler_next_timer_ns(const executor_scheduler_t * scheduler, int64_t limit)
+{
+	for (size_t e = 0; e < scheduler->count; e++) {
+		const rclc_executor_t * executor = scheduler->entries[e].executor;
+		if (scheduler->entries[e].pending) {
+			continue;
+		}
+		for (size_t i = 0; i < executor->max_handles && executor->handles[i].initialized; i++) {
+			int64_t until_next;
+			if (executor->handles[i].type == RCLC_TIMER &&
+				rcl_timer_get_time_until_next_call(executor->handles[i].timer, &until_next) == RCL_RET_OK &&
+				until_next > 0 && until_next < limit) {
+				limit = until_next;
+			}
+		}
+	}
+	return limit;
+}
+
+// One round of the dispatcher, see the top of this file
+static inline void executor_scheduler_dispatch(executor_scheduler_t * scheduler)
+{
+	uint64_t now = EXECUTOR_SCHEDULER_NOW_US();
+	executor_scheduler_entry_t * waiter = NULL;
+	size_t pending = 0;
+
+	for (size_t i = 0; i < scheduler->count; i++) {
+		executor_scheduler_entry_t * entry = scheduler->order[i];
+		if (!entry->pending && now >= entry->retry_us) {
+			executor_scheduler_poll(entry, 0);
+			if (!entry->pending && waiter == NULL) {
+				waiter = entry;
+			}
+		}
+		pending += entry->pending;
+	}
+
+	if (pending > 0) {
+		// Leave the session to the workers until one of them is done or it is time to poll
+		int64_t timeout = executor_scheduler_next_timer_ns(scheduler, RCL_MS_TO_NS(EXECUTOR_SCHEDULER_POLL_MS));
+		scheduler->idle = false;
+#ifdef INC_FREERTOS_H
+		ulTaskNotifyTake(pdTRUE, executor_scheduler_ticks(timeout));
+#else
+		struct timespec until;
+		clock_gettime(CLOCK_REALTIME, &until);
+		until.tv_nsec += (long)timeout;
+		while (until.tv_nsec >= 1000000000) {
+			until.tv_sec++;
+			until.tv_nsec -= 1000000000;
+		}
+		sem_timedwait(&scheduler->done, &until);
+#endif
+		return;
+	}
+
+	if (waiter == NULL) {
+		// Every executor is backing off after an error
+		executor_scheduler_sleep(RCL_MS_TO_NS(EXECUTOR_SCHEDULER_WAIT_MS));
+		return;
+	}
+
+	if (scheduler->idle) {
+		// The last wait ended for data no trigger accepts and would end at once again
+		scheduler->idle_pauses++;
+		executor_scheduler_sleep(RCL_MS_TO_NS(EXECUTOR_SCHEDULER_POLL_MS));
+	}
+
+	// Wait on the session for every executor: any data ends the wait
+	int64_t timeout = executor_scheduler_next_timer_ns(scheduler, RCL_MS_TO_NS(EXECUTOR_SCHEDULER_WAIT_MS));
+	uint64_t start = EXECUTOR_SCHEDULER_NOW_US();
+	scheduler->waits++;
+	bool handed = executor_scheduler_poll(waiter, timeout);
+	scheduler->idle = !handed && (int64_t)(EXECUTOR_SCHEDULER_NOW_US() - start) * 1000 < timeout;
+}
+
+// Worker: runs the work the dispatcher handed over
+static inline void executor_scheduler_run(executor_scheduler_entry_t * entry)
+{
+#ifdef INC_FREERTOS_H
+	ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+#else
+	while (sem_wait(&entry->work) != 0) {
+		// interrupted by a signal
+	}
+#endif
+
+	entry->executed = false;
+	executor_scheduler_failed(entry, rclc_executor_spin_some(entry->executor, 0));
+
+	if (entry->executed) {
+		uint64_t response = EXECUTOR_SCHEDULER_NOW_US() - entry->ready_us;
+		latency_histogram_record(&entry->response_us, response > UINT32_MAX ? UINT32_MAX : (uint32_t)response);
+		entry->dispatches++;
+		if (entry->deadline_us > 0 && response > entry->deadline_us) {
+			entry->misses++;
+		}
+	}
+
+	entry->pending = false;
+#ifdef INC_FREERTOS_H
+	xTaskNotifyGive(entry->scheduler->dispatcher);
+#else
+	sem_post(&entry->scheduler->done);
+#endif
+}
+
+#ifdef INC_FREERTOS_H
+static inline void executor_scheduler_dispatcher_task(void * arg)
+{
+	while(1){
+		executor_scheduler_dispatch((executor_scheduler_t *)arg);
+	}
+}
+
+static inline void executor_scheduler_worker_task(void * arg)
+{
+	while(1){
+		executor_scheduler_run((executor_scheduler_entry_t *)arg);
+	}
+}
+#else
+static inline void * executor_scheduler_dispatcher_task(void * arg)
+{
+	while(1){
+		executor_scheduler_dispatch((executor_scheduler_t *)arg);
+	}
+	return NULL;
+}
+
+static inline void * executor_scheduler_worker_task(void * arg)
+{
+	while(1){
+		executor_scheduler_run((executor_scheduler_entry_t *)arg);
+	}
+	return NULL;
+}
+
+// SCHED_FIFO thread at 'priority', clamped to the valid range; false with
+// the thread started under the default policy when SCHED_FIFO is not
+// permitted (no CAP_SYS_NICE)
+static inline bool executor_scheduler_thread(pthread_t * thread, int priority, void * (*function)(void *), void * arg, bool * started)
+{
+	pthread_attr_t attr;
+	struct sched_param param;
+	int min = sched_get_priority_min(SCHED_FIFO);
+	int max = sched_get_priority_max(SCHED_FIFO);
+
+	param.sched_priority = priority < min ? min : (priority > max ? max : priority);
+	pthread_attr_init(&attr);
+	pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+	pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+	pthread_attr_setschedparam(&attr, &param);
+
+	bool realtime = (pthread_create(thread, &attr, function, arg) == 0);
+	pthread_attr_destroy(&attr);
+	*started = realtime || pthread_create(thread, NULL, function, arg) == 0;
+	return realtime;
+}
+#endif
+
+// Starts one worker per executor, then the dispatcher one priority above
+// the most urgent of them. On POSIX a task falls back to the default policy
+// when SCHED_FIFO is not permitted.
+static inline bool executor_scheduler_start(executor_scheduler_t * scheduler)
+{
+	if (scheduler->count == 0) {
+		return false;
+	}
+	int priority = scheduler->order[0]->priority + 1;
+
+#ifdef INC_FREERTOS_H
+	if (priority > configMAX_PRIORITIES - 1) {
+		priority = configMAX_PRIORITIES - 1;
+	}
+	for (size_t i = 0; i < scheduler->count; i++) {
+		executor_scheduler_entry_t * entry = &scheduler->entries[i];
+		if (xTaskCreate(executor_scheduler_worker_task, entry->name, EXECUTOR_SCHEDULER_STACK_SIZE,
+			entry, entry->priority, &entry->task) != pdPASS) {
+			return false;
+		}
+	}
+	if (xTaskCreate(executor_scheduler_dispatcher_task, "executor_dispatch", EXECUTOR_SCHEDULER_STACK_SIZE,
+		scheduler, priority, &scheduler->dispatcher) != pdPASS) {
+		return false;
+	}
+#else
+	bool started;
+	sem_init(&scheduler->done, 0, 0);
+	for (size_t i = 0; i < scheduler->count; i++) {
+		executor_scheduler_entry_t * entry = &scheduler->entries[i];
+		sem_init(&entry->work, 0, 0);
+		entry->realtime = executor_scheduler_thread(&entry->thread, entry->priority, executor_scheduler_worker_task, entry, &started);
+		if (!started) {
+			return false;
+		}
+	}
+	scheduler->realtime = executor_scheduler_thread(&scheduler->dispatcher, priority, executor_scheduler_dispatcher_task, scheduler, &started);
+	if (!started) {
+		return false;
+	}
+#endif
+	scheduler->started = true;
+	return true;
+}
+
+static inline void executor_scheduler_print(const executor_scheduler_t * scheduler)
+{
+	printf("dispatcher%s: waits %u, idle pauses %u\n",
+#ifdef INC_FREERTOS_H
+		"",
+#else
+		scheduler->realtime ? "" : " (no SCHED_FIFO)",
+#endif
+		(unsigned int)scheduler->waits, (unsigned int)scheduler->idle_pauses);
+	for (size_t i = 0; i < scheduler->count; i++) {
+		const executor_scheduler_entry_t * entry = scheduler->order[i];
+		printf("%s (priority %d%s): dispatches %u, response us p50 %u p99 %u max %u, deadline %u us missed %u, errors %u\n",
+			entry->name, entry->priority,
+#ifdef INC_FREERTOS_H
+			"",
+#else
+			entry->realtime ? "" : ", no SCHED_FIFO",
+#endif
+			(unsigned int)entry->dispatches,
+			(unsigned int)latency_histogram_percentile(&entry->response_us, 500),
+			(unsigned int)latency_histogram_percentile(&entry->response_us, 990),
+			(unsigned int)entry->response_us.max,
+			(unsigned int)entry->deadline_us, (unsigned int)entry->misses, (unsigned int)entry->errors);
+	}
+}
+
+#endif /* EXECUTOR_SCHEDULER_H_ */
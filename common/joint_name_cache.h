@@ -0,0 +1,157 @@
+#ifndef JOINT_NAME_CACHE_H_
+#define JOINT_NAME_CACHE_H_
+
+// Joint name to slot cache for sensor_msgs/JointState.
+//
+// Every JointState repeats the joint names, and values have to be matched
+// to joints by name because publishers do not promise a fixed order.
+// Matching by string compare costs O(joints * slots) per message. The cache
+// does the matching once: it keeps the slot of every position in the name
+// vector, keyed by an FNV-1a hash of the whole vector. A later message
+// only hashes its names, one pass over the bytes, and reuses the map while
+// the hash matches. The map is rebuilt only when the order or the set of
+// names changes.
+//
+// Slots are either given up front (joint_name_cache_init() with a name
+// list) or learned: with no list, every new name takes the next free slot,
+// so a joint keeps its slot however the publisher orders the names later.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+#include <rosidl_runtime_c/string.h>
+
+#ifndef JOINT_NAME_CACHE_MAX_SLOTS
+#define JOINT_NAME_CACHE_MAX_SLOTS 32
+#endif
+
+// Learned names longer than this are truncated
+#ifndef JOINT_NAME_CACHE_NAME_LEN
+#define JOINT_NAME_CACHE_NAME_LEN 32
+#endif
+
+#define JOINT_NAME_CACHE_FNV_OFFSET 2166136261u
+#define JOINT_NAME_CACHE_FNV_PRIME 16777619u
+
+// Slot of a name that is not in the given list
+#define JOINT_NAME_CACHE_UNKNOWN (-1)
+
+typedef struct joint_name_cache_t {
+	char names[JOINT_NAME_CACHE_MAX_SLOTS][JOINT_NAME_CACHE_NAME_LEN];
+	size_t slot_count;
+	bool learn;
+	// Map of the last name vector: position i of the message -> slot
+	int8_t map[JOINT_NAME_CACHE_MAX_SLOTS];
+	size_t count;
+	uint32_t hash;
+	bool valid;
+	bool identity;          // map[i] == i for every i, values need no reordering
+	// Statistics
+	uint32_t hits;
+	uint32_t rebuilds;
+	uint32_t unknown;       // names without a slot, summed over rebuilds
+} joint_name_cache_t;
+
+static inline uint32_t joint_name_cache_hash(const rosidl_runtime_c__String * names, size_t count)
+{
+	uint32_t hash = JOINT_NAME_CACHE_FNV_OFFSET;
+
+	for (size_t i = 0; i < count; i++) {
+		const uint8_t * c = (const uint8_t *)names[i].data;
+		for (size_t b = 0; b < names[i].size; b++) {
+			hash = (hash ^ c[b]) * JOINT_NAME_CACHE_FNV_PRIME;
+		}
+		// Separator, so that {"ab", "c"} and {"a", "bc"} differ
+		hash = (hash ^ 0xFFu) * JOINT_NAME_CACHE_FNV_PRIME;
+	}
+	return hash;
+}
+
+// 'slot_names' may be NULL to learn the slots from the messages
+static inline void joint_name_cache_init(joint_name_cache_t * cache, const char * const * slot_names, size_t slot_count)
+{
+	if (slot_count > JOINT_NAME_CACHE_MAX_SLOTS) {
+		slot_count = JOINT_NAME_CACHE_MAX_SLOTS;
+	}
+
+	cache->learn = (slot_names == NULL);
+	cache->slot_count = cache->learn ? 0 : slot_count;
+	for (size_t s = 0; s < cache->slot_count; s++) {
+		strncpy(cache->names[s], slot_names[s], JOINT_NAME_CACHE_NAME_LEN - 1);
+		cache->names[s][JOINT_NAME_CACHE_NAME_LEN - 1] = '\0';
+	}
+
+	cache->count = 0;
+	cache->hash = 0;
+	cache->valid = false;
+	cache->identity = false;
+	cache->hits = 0;
+	cache->rebuilds = 0;
+	cache->unknown = 0;
+}
+
+static inline int joint_name_cache_find(joint_name_cache_t * cache, const rosidl_runtime_c__String * name)
+{
+	size_t length = (name->size < JOINT_NAME_CACHE_NAME_LEN - 1) ? name->size : JOINT_NAME_CACHE_NAME_LEN - 1;
+
+	for (size_t s = 0; s < cache->slot_count; s++) {
+		if (strncmp(cache->names[s], name->data, length) == 0 && cache->names[s][length] == '\0') {
+			return (int)s;
+		}
+	}
+
+	if (!cache->learn || cache->slot_count >= JOINT_NAME_CACHE_MAX_SLOTS) {
+		return JOINT_NAME_CACHE_UNKNOWN;
+	}
+
+	memcpy(cache->names[cache->slot_count], name->data, length);
+	cache->names[cache->slot_count][length] = '\0';
+	return (int)cache->slot_count++;
+}
+
+// Maps the names of a message to slots and returns the map, map[i] being the
+// slot of value i or JOINT_NAME_CACHE_UNKNOWN. At most MAX_SLOTS names are
+// mapped; *count is set to how many.
+static inline const int8_t * joint_name_cache_update(joint_name_cache_t * cache,
+	const rosidl_runtime_c__String * names, size_t * count)
+{
+	size_t n = (*count < JOINT_NAME_CACHE_MAX_SLOTS) ? *count : JOINT_NAME_CACHE_MAX_SLOTS;
+	uint32_t hash = joint_name_cache_hash(names, n);
+
+	*count = n;
+	if (cache->valid && hash == cache->hash && n == cache->count) {
+		cache->hits++;
+		return cache->map;
+	}
+
+	cache->identity = true;
+	for (size_t i = 0; i < n; i++) {
+		int slot = joint_name_cache_find(cache, &names[i]);
+		cache->map[i] = (int8_t)slot;
+		cache->identity = cache->identity && (slot == (int)i);
+		cache->unknown += (slot == JOINT_NAME_CACHE_UNKNOWN);
+	}
+
+	cache->count = n;
+	cache->hash = hash;
+	cache->valid = true;
+	cache->rebuilds++;
+	return cache->map;
+}
+
+// Scatters 'values' (message order) into 'slots' (slot order). A joint named
+// in the message past the end of 'values' (e.g. no effort) gets 0, like
+// joint_pipeline_load() zero fills short arrays; slots of joints the message
+// does not name are left untouched.
+static inline void joint_name_cache_scatter(const joint_name_cache_t * cache, const double * values, size_t value_count, double * slots)
+{
+	for (size_t i = 0; i < cache->count; i++) {
+		if (cache->map[i] != JOINT_NAME_CACHE_UNKNOWN) {
+			slots[cache->map[i]] = (i < value_count) ? values[i] : 0.0;
+		}
+	}
+}
+
+#endif /* JOINT_NAME_CACHE_H_ */
@@ -0,0 +1,257 @@
+#ifndef JOINT_PIPELINE_H_
+#define JOINT_PIPELINE_H_
+
+// Structure-of-arrays joint state processing.
+//
+// joint_pipeline_load() converts the position, velocity and effort
+// sequences of a JointState into float arrays, one per quantity, aligned
+// and padded to whole vectors. joint_pipeline_process() then runs every
+// stage over JOINT_PIPELINE_LANES joints at a time with GCC vector
+// extensions:
+//   - first-order low-pass filter of position and velocity
+//   - clamp of the filtered velocity to +-velocity_limit
+//   - position range check against per-joint limits
+//   - NaN check of every input
+// and returns bit masks of the affected joints, bit i for joint i.
+//
+// The vector width is generic, so the compiler uses SSE/NEON where there
+// is one and splits the operations into scalar code where there is not
+// (ESP32), which still saves the per-joint double arithmetic and branches.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+// Fixed: joint_pipeline_process() spells out the lane bits
+#define JOINT_PIPELINE_LANES 4
+
+// Also the width of the result masks
+#ifndef JOINT_PIPELINE_MAX_JOINTS
+#define JOINT_PIPELINE_MAX_JOINTS 32
+#endif
+
+#if JOINT_PIPELINE_MAX_JOINTS > 32 || JOINT_PIPELINE_MAX_JOINTS % JOINT_PIPELINE_LANES != 0
+#error "JOINT_PIPELINE_MAX_JOINTS must be a multiple of JOINT_PIPELINE_LANES and at most 32"
+#endif
+
+#define JOINT_PIPELINE_VECTORS (JOINT_PIPELINE_MAX_JOINTS / JOINT_PIPELINE_LANES)
+
+typedef float joint_pipeline_vec_t __attribute__((vector_size(JOINT_PIPELINE_LANES * sizeof(float))));
+typedef int32_t joint_pipeline_mask_t __attribute__((vector_size(JOINT_PIPELINE_LANES * sizeof(int32_t))));
+typedef double joint_pipeline_dvec_t __attribute__((vector_size(JOINT_PIPELINE_LANES * sizeof(double))));
+
+typedef struct joint_pipeline_result_t {
+	uint32_t out_of_range;
+	uint32_t clamped;
+	uint32_t nan;
+} joint_pipeline_result_t;
+
+typedef struct joint_pipeline_t {
+	// Inputs of the latest message
+	joint_pipeline_vec_t position[JOINT_PIPELINE_VECTORS];
+	joint_pipeline_vec_t velocity[JOINT_PIPELINE_VECTORS];
+	joint_pipeline_vec_t effort[JOINT_PIPELINE_VECTORS];
+	// Filter state, i.e. the outputs
+	joint_pipeline_vec_t filtered_position[JOINT_PIPELINE_VECTORS];
+	joint_pipeline_vec_t filtered_velocity[JOINT_PIPELINE_VECTORS];
+	// Limits
+	joint_pipeline_vec_t position_min[JOINT_PIPELINE_VECTORS];
+	joint_pipeline_vec_t position_max[JOINT_PIPELINE_VECTORS];
+	float alpha;
+	float velocity_limit;
+	size_t count;
+	bool primed;
+	// Statistics
+	uint32_t messages;
+	uint32_t out_of_range;
+	uint32_t clamped;
+	uint32_t nan;
+} joint_pipeline_t;
+
+static inline float joint_pipeline_get(const joint_pipeline_vec_t * array, size_t joint)
+{
+	return array[joint / JOINT_PIPELINE_LANES][joint % JOINT_PIPELINE_LANES];
+}
+
+// 'alpha' is the filter weight of a new sample (1: no filtering). Every joint
+// starts with the position range [position_min, position_max].
+static inline void joint_pipeline_init(joint_pipeline_t * pipeline, float alpha, float velocity_limit,
+	float position_min, float position_max)
+{
+	for (size_t v = 0; v < JOINT_PIPELINE_VECTORS; v++) {
+		for (size_t l = 0; l < JOINT_PIPELINE_LANES; l++) {
+			pipeline->position[v][l] = 0.0f;
+			pipeline->velocity[v][l] = 0.0f;
+			pipeline->effort[v][l] = 0.0f;
+			pipeline->filtered_position[v][l] = 0.0f;
+			pipeline->filtered_velocity[v][l] = 0.0f;
+			pipeline->position_min[v][l] = position_min;
+			pipeline->position_max[v][l] = position_max;
+		}
+	}
+	pipeline->alpha = alpha;
+	pipeline->velocity_limit = velocity_limit;
+	pipeline->count = 0;
+	pipeline->primed = false;
+	pipeline->messages = 0;
+	pipeline->out_of_range = 0;
+	pipeline->clamped = 0;
+	pipeline->nan = 0;
+}
+
+static inline void joint_pipeline_set_limits(joint_pipeline_t * pipeline, size_t joint, float position_min, float position_max)
+{
+	if (joint < JOINT_PIPELINE_MAX_JOINTS) {
+		pipeline->position_min[joint / JOINT_PIPELINE_LANES][joint % JOINT_PIPELINE_LANES] = position_min;
+		pipeline->position_max[joint / JOINT_PIPELINE_LANES][joint % JOINT_PIPELINE_LANES] = position_max;
+	}
+}
+
+static inline void joint_pipeline_load_array(joint_pipeline_vec_t * out, const double * in, size_t in_count, size_t count)
+{
+	float * lanes = (float *)out;
+	size_t n = (in_count < count) ? in_count : count;
+	size_t padded = (count + JOINT_PIPELINE_LANES - 1) / JOINT_PIPELINE_LANES * JOINT_PIPELINE_LANES;
+	size_t i = 0;
+
+#if defined(__GNUC__) && __GNUC__ >= 9
+	// Whole vectors at a time; sequences of doubles are only 8-byte aligned
+	for (; i + JOINT_PIPELINE_LANES <= n; i += JOINT_PIPELINE_LANES) {
+		joint_pipeline_dvec_t wide;
+		memcpy(&wide, &in[i], sizeof(wide));
+		out[i / JOINT_PIPELINE_LANES] = __builtin_convertvector(wide, joint_pipeline_vec_t);
+	}
+	// The tail, 1 to 3 values, as one zero-padded vector built in registers:
+	// partial stores into a vector in memory would stall its reload
+	if (i < n) {
+		size_t rest = n - i;
+		joint_pipeline_dvec_t wide = {
+			in[i],
+			(rest > 1) ? in[i + 1] : 0.0,
+			(rest > 2) ? in[i + 2] : 0.0,
+			0.0,
+		};
+		out[i / JOINT_PIPELINE_LANES] = __builtin_convertvector(wide, joint_pipeline_vec_t);
+		i += JOINT_PIPELINE_LANES;
+	}
+#endif
+	for (; i < n; i++) {
+		lanes[i] = (float)in[i];
+	}
+	// Missing values and padding lanes read as 0 and never raise a flag
+	for (; i < padded; i++) {
+		lanes[i] = 0.0f;
+	}
+}
+
+// Takes up to JOINT_PIPELINE_MAX_JOINTS joints; 'count' is the number of
+// joints, shorter arrays (e.g. no effort) are zero filled
+static inline size_t joint_pipeline_load(joint_pipeline_t * pipeline, size_t count,
+	const double * position, size_t position_count,
+	const double * velocity, size_t velocity_count,
+	const double * effort, size_t effort_count)
+{
+	if (count > JOINT_PIPELINE_MAX_JOINTS) {
+		count = JOINT_PIPELINE_MAX_JOINTS;
+	}
+	if (count != pipeline->count) {
+		pipeline->primed = false;
+	}
+	pipeline->count = count;
+
+	joint_pipeline_load_array(pipeline->position, position, position_count, count);
+	joint_pipeline_load_array(pipeline->velocity, velocity, velocity_count, count);
+	joint_pipeline_load_array(pipeline->effort, effort, effort_count, count);
+	return count;
+}
+
+// Folds the per-lane joint bits gathered by joint_pipeline_process() into one mask
+static inline uint32_t joint_pipeline_bits(joint_pipeline_mask_t bits)
+{
+	uint32_t folded = 0;
+	for (size_t l = 0; l < JOINT_PIPELINE_LANES; l++) {
+		folded |= (uint32_t)bits[l];
+	}
+	return folded;
+}
+
+// Per lane: 'a' where 'mask' is set, 'b' elsewhere
+static inline joint_pipeline_vec_t joint_pipeline_select(joint_pipeline_mask_t mask, joint_pipeline_vec_t a, joint_pipeline_vec_t b)
+{
+	return (joint_pipeline_vec_t)(((joint_pipeline_mask_t)a & mask) | ((joint_pipeline_mask_t)b & ~mask));
+}
+
+static inline joint_pipeline_result_t joint_pipeline_process(joint_pipeline_t * pipeline)
+{
+	joint_pipeline_result_t result = {0, 0, 0};
+	// Bit of joint v * LANES + l in lane l, shifted up by LANES per vector
+	joint_pipeline_mask_t joint_bits = {1, 2, 4, 8};
+	joint_pipeline_mask_t nan_bits = {0};
+	joint_pipeline_mask_t clamped_bits = {0};
+	joint_pipeline_mask_t range_bits = {0};
+	size_t vectors = (pipeline->count + JOINT_PIPELINE_LANES - 1) / JOINT_PIPELINE_LANES;
+	const float limit = pipeline->velocity_limit;
+	const joint_pipeline_vec_t zero = {0.0f};
+	const joint_pipeline_vec_t alpha = zero + pipeline->alpha;
+	const joint_pipeline_vec_t upper = zero + limit;
+	const joint_pipeline_vec_t lower = zero - limit;
+
+	for (size_t v = 0; v < vectors; v++) {
+		joint_pipeline_vec_t position = pipeline->position[v];
+		joint_pipeline_vec_t velocity = pipeline->velocity[v];
+		joint_pipeline_vec_t effort = pipeline->effort[v];
+
+		// NaN is the only value that differs from itself; a NaN input keeps the previous output
+		joint_pipeline_mask_t nan = (position != position) | (velocity != velocity) | (effort != effort);
+		joint_pipeline_mask_t valid = ~nan;
+
+		joint_pipeline_vec_t fp = pipeline->filtered_position[v];
+		joint_pipeline_vec_t fv = pipeline->filtered_velocity[v];
+
+		// The first message initializes the filter instead of ramping up from zero
+		if (!pipeline->primed) {
+			fp = joint_pipeline_select(valid, position, zero);
+			fv = joint_pipeline_select(valid, velocity, zero);
+		}
+		joint_pipeline_vec_t next_fp = fp + alpha * (position - fp);
+		joint_pipeline_vec_t next_fv = fv + alpha * (velocity - fv);
+
+		joint_pipeline_mask_t over = next_fv > upper;
+		joint_pipeline_mask_t under = next_fv < lower;
+		next_fv = joint_pipeline_select(over, upper, next_fv);
+		next_fv = joint_pipeline_select(under, lower, next_fv);
+
+		fp = joint_pipeline_select(valid, next_fp, fp);
+		fv = joint_pipeline_select(valid, next_fv, fv);
+		pipeline->filtered_position[v] = fp;
+		pipeline->filtered_velocity[v] = fv;
+
+		joint_pipeline_mask_t range = (fp < pipeline->position_min[v]) | (fp > pipeline->position_max[v]);
+
+		nan_bits |= nan & joint_bits;
+		clamped_bits |= (over | under) & valid & joint_bits;
+		range_bits |= range & joint_bits;
+		joint_bits <<= JOINT_PIPELINE_LANES;
+	}
+
+	result.nan = joint_pipeline_bits(nan_bits);
+	result.clamped = joint_pipeline_bits(clamped_bits);
+	result.out_of_range = joint_pipeline_bits(range_bits);
+
+	pipeline->primed = true;
+
+	// Padding lanes past the last joint do not count
+	uint32_t used = (pipeline->count >= 32) ? 0xFFFFFFFFu : ((1u << pipeline->count) - 1);
+	result.nan &= used;
+	result.clamped &= used;
+	result.out_of_range &= used;
+
+	pipeline->messages++;
+	pipeline->out_of_range += (result.out_of_range != 0);
+	pipeline->clamped += (result.clamped != 0);
+	pipeline->nan += (result.nan != 0);
+	return result;
+}
+
+#endif /* JOINT_PIPELINE_H_ */
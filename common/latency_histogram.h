@@ -0,0 +1,115 @@
+#ifndef LATENCY_HISTOGRAM_H_
+#define LATENCY_HISTOGRAM_H_
+
+// Fixed-memory, log-bucketed (HDR style) latency histogram.
+//
+// Values are unsigned 32-bit samples (the apps record microseconds). Every
+// power of two is split into LATENCY_HISTOGRAM_SUB_COUNT linear sub-buckets,
+// so the reported value of any percentile is within 1/SUB_COUNT of the real
+// one while the whole histogram stays a flat array of counters.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+// Sub-buckets per power of two: 4 bits -> 16 sub-buckets -> ~6% precision
+#ifndef LATENCY_HISTOGRAM_SUB_BITS
+#define LATENCY_HISTOGRAM_SUB_BITS 4
+#endif
+
+// Largest recordable value is 2^VALUE_BITS - 1; larger samples are clamped
+#ifndef LATENCY_HISTOGRAM_VALUE_BITS
+#define LATENCY_HISTOGRAM_VALUE_BITS 24
+#endif
+
+#define LATENCY_HISTOGRAM_SUB_COUNT (1u << LATENCY_HISTOGRAM_SUB_BITS)
+#define LATENCY_HISTOGRAM_BUCKETS \
+	((LATENCY_HISTOGRAM_VALUE_BITS - LATENCY_HISTOGRAM_SUB_BITS + 1) * LATENCY_HISTOGRAM_SUB_COUNT)
+#define LATENCY_HISTOGRAM_MAX_VALUE \
+	((uint32_t)((1ull << LATENCY_HISTOGRAM_VALUE_BITS) - 1))
+
+typedef struct latency_histogram_t {
+	uint32_t counts[LATENCY_HISTOGRAM_BUCKETS];
+	uint32_t total;
+	uint32_t min;
+	uint32_t max;
+	uint32_t clamped;
+} latency_histogram_t;
+
+static inline unsigned int latency_histogram_msb(uint32_t value)
+{
+	return 31u - (unsigned int)__builtin_clz(value);
+}
+
+static inline unsigned int latency_histogram_index(uint32_t value)
+{
+	if (value < LATENCY_HISTOGRAM_SUB_COUNT) {
+		return value;
+	}
+
+	unsigned int shift = latency_histogram_msb(value) - LATENCY_HISTOGRAM_SUB_BITS;
+	return (shift + 1) * LATENCY_HISTOGRAM_SUB_COUNT + ((value >> shift) - LATENCY_HISTOGRAM_SUB_COUNT);
+}
+
+// Highest value that falls into the given bucket
+static inline uint32_t latency_histogram_bucket_top(unsigned int index)
+{
+	if (index < LATENCY_HISTOGRAM_SUB_COUNT) {
+		return index;
+	}
+
+	unsigned int shift = index / LATENCY_HISTOGRAM_SUB_COUNT - 1;
+	uint32_t sub = index % LATENCY_HISTOGRAM_SUB_COUNT + LATENCY_HISTOGRAM_SUB_COUNT;
+	return (uint32_t)((((uint64_t)sub + 1) << shift) - 1);
+}
+
+static inline void latency_histogram_reset(latency_histogram_t * hist)
+{
+	memset(hist, 0, sizeof(*hist));
+	hist->min = UINT32_MAX;
+}
+
+static inline void latency_histogram_record(latency_histogram_t * hist, uint32_t value)
+{
+	if (value > LATENCY_HISTOGRAM_MAX_VALUE) {
+		value = LATENCY_HISTOGRAM_MAX_VALUE;
+		hist->clamped++;
+	}
+
+	hist->counts[latency_histogram_index(value)]++;
+	hist->total++;
+
+	if (value < hist->min) {
+		hist->min = value;
+	}
+	if (value > hist->max) {
+		hist->max = value;
+	}
+}
+
+// Value at or below which 'per_mille' thousandths of the samples fall
+// (500 -> p50, 990 -> p99). Returns 0 on an empty histogram.
+static inline uint32_t latency_histogram_percentile(const latency_histogram_t * hist, uint32_t per_mille)
+{
+	if (hist->total == 0) {
+		return 0;
+	}
+
+	uint64_t rank = ((uint64_t)hist->total * per_mille + 999) / 1000;
+	if (rank == 0) {
+		rank = 1;
+	}
+
+	uint64_t seen = 0;
+	for (unsigned int i = 0; i < LATENCY_HISTOGRAM_BUCKETS; i++) {
+		seen += hist->counts[i];
+		if (seen >= rank) {
+			uint32_t top = latency_histogram_bucket_top(i);
+			return (top < hist->max) ? top : hist->max;
+		}
+	}
+
+	return hist->max;
+}
+
+#endif /* LATENCY_HISTOGRAM_H_ */
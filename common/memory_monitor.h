@@ -0,0 +1,155 @@
+#ifndef MEMORY_MONITOR_H_
+#define MEMORY_MONITOR_H_
+
+// Periodic memory telemetry.
+//
+// memory_monitor_sample() reads a handful of counters, all O(1) except the
+// per-task stack scan, and stores them as a flat uint32 array ready to be
+// published as a UInt32MultiArray:
+//   [0] samples taken
+//   [1] heap bytes free now
+//   [2] lowest heap bytes free ever seen
+//   [3] allocator bytes in use
+//   [4] allocator bytes in use, high-water mark
+//   [5] message pool blocks in use, high-water mark (0 without message_pool.h)
+//   [6...] stack high-water mark of every registered task, in the port's
+//          unit (bytes on ESP-IDF, words on other FreeRTOS ports)
+//
+// Heap figures come from esp_get_*_free_heap_size() on ESP32,
+// xPortGetFreeHeapSize() / xPortGetMinimumEverFreeHeapSize() on other
+// FreeRTOS ports and mallinfo() on the host. The allocator figures default
+// to the pool allocator arena when pool_allocator.h was included first, to
+// the heap figures otherwise; define MEMORY_MONITOR_ALLOCATOR_USED() and
+// MEMORY_MONITOR_ALLOCATOR_PEAK() before including this header to report
+// another allocator (e.g. usedMemory on the Crazyflie).
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#if defined(ESP_PLATFORM)
+#include "esp_system.h"
+#include "esp_heap_caps.h"
+#elif !defined(INC_FREERTOS_H) && defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+#ifndef MEMORY_MONITOR_MAX_TASKS
+#define MEMORY_MONITOR_MAX_TASKS 4
+#endif
+
+#define MEMORY_MONITOR_SAMPLES 0
+#define MEMORY_MONITOR_HEAP_FREE 1
+#define MEMORY_MONITOR_HEAP_MIN_FREE 2
+#define MEMORY_MONITOR_ALLOC_USED 3
+#define MEMORY_MONITOR_ALLOC_PEAK 4
+#define MEMORY_MONITOR_POOL_PEAK 5
+#define MEMORY_MONITOR_TASK_STACK 6
+#define MEMORY_MONITOR_MAX_FIELDS (MEMORY_MONITOR_TASK_STACK + MEMORY_MONITOR_MAX_TASKS)
+
+typedef struct memory_monitor_t {
+	uint32_t fields[MEMORY_MONITOR_MAX_FIELDS];
+	size_t field_count;
+#ifdef INC_FREERTOS_H
+	TaskHandle_t tasks[MEMORY_MONITOR_MAX_TASKS];
+#endif
+	size_t task_count;
+} memory_monitor_t;
+
+static inline void memory_monitor_heap(uint32_t * free_now, uint32_t * free_min, uint32_t * used)
+{
+#if defined(ESP_PLATFORM)
+	*free_now = esp_get_free_heap_size();
+	*free_min = esp_get_minimum_free_heap_size();
+	*used = heap_caps_get_total_size(MALLOC_CAP_DEFAULT) - *free_now;
+#elif defined(INC_FREERTOS_H)
+	*free_now = xPortGetFreeHeapSize();
+	*free_min = xPortGetMinimumEverFreeHeapSize();
+	*used = configTOTAL_HEAP_SIZE - *free_now;
+#elif defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+	struct mallinfo2 info = mallinfo2();
+	*free_now = (uint32_t)info.fordblks;
+	*free_min = *free_now;
+	*used = (uint32_t)info.uordblks;
+#elif defined(__GLIBC__)
+	struct mallinfo info = mallinfo();
+	*free_now = (uint32_t)info.fordblks;
+	*free_min = *free_now;
+	*used = (uint32_t)info.uordblks;
+#else
+	*free_now = 0;
+	*free_min = 0;
+	*used = 0;
+#endif
+}
+
+static inline void memory_monitor_init(memory_monitor_t * monitor)
+{
+	for (size_t i = 0; i < MEMORY_MONITOR_MAX_FIELDS; i++) {
+		monitor->fields[i] = 0;
+	}
+	monitor->fields[MEMORY_MONITOR_HEAP_MIN_FREE] = UINT32_MAX;
+	monitor->field_count = MEMORY_MONITOR_TASK_STACK;
+	monitor->task_count = 0;
+}
+
+#ifdef INC_FREERTOS_H
+// Adds a task to the stack report, NULL for the calling task
+static inline bool memory_monitor_add_task(memory_monitor_t * monitor, TaskHandle_t task)
+{
+	if (monitor->task_count >= MEMORY_MONITOR_MAX_TASKS) {
+		return false;
+	}
+
+	monitor->tasks[monitor->task_count++] = (task != NULL) ? task : xTaskGetCurrentTaskHandle();
+	monitor->field_count = MEMORY_MONITOR_TASK_STACK + monitor->task_count;
+	return true;
+}
+#endif
+
+static inline void memory_monitor_sample(memory_monitor_t * monitor)
+{
+	uint32_t * fields = monitor->fields;
+	uint32_t free_now, free_min, used;
+
+	memory_monitor_heap(&free_now, &free_min, &used);
+	fields[MEMORY_MONITOR_SAMPLES]++;
+	fields[MEMORY_MONITOR_HEAP_FREE] = free_now;
+	if (free_min < fields[MEMORY_MONITOR_HEAP_MIN_FREE]) {
+		fields[MEMORY_MONITOR_HEAP_MIN_FREE] = free_min;
+	}
+
+#if defined(MEMORY_MONITOR_ALLOCATOR_USED)
+	fields[MEMORY_MONITOR_ALLOC_USED] = (uint32_t)MEMORY_MONITOR_ALLOCATOR_USED();
+#elif defined(POOL_ALLOCATOR_H_)
+	uint32_t pool_used = 0;
+	for (int tag = 0; tag < POOL_TAG_COUNT; tag++) {
+		pool_used += (uint32_t)pool_allocator_get_stats((pool_allocator_tag_t)tag).bytes;
+	}
+	fields[MEMORY_MONITOR_ALLOC_USED] = pool_used;
+#else
+	fields[MEMORY_MONITOR_ALLOC_USED] = used;
+#endif
+
+#if defined(MEMORY_MONITOR_ALLOCATOR_PEAK)
+	fields[MEMORY_MONITOR_ALLOC_PEAK] = (uint32_t)MEMORY_MONITOR_ALLOCATOR_PEAK();
+#elif defined(POOL_ALLOCATOR_H_)
+	fields[MEMORY_MONITOR_ALLOC_PEAK] = (uint32_t)pool_allocator_arena_used();
+#else
+	if (fields[MEMORY_MONITOR_ALLOC_USED] > fields[MEMORY_MONITOR_ALLOC_PEAK]) {
+		fields[MEMORY_MONITOR_ALLOC_PEAK] = fields[MEMORY_MONITOR_ALLOC_USED];
+	}
+#endif
+
+#ifdef MESSAGE_POOL_H_
+	fields[MEMORY_MONITOR_POOL_PEAK] = message_pool_get_stats().high_water;
+#endif
+
+#ifdef INC_FREERTOS_H
+	for (size_t i = 0; i < monitor->task_count; i++) {
+		fields[MEMORY_MONITOR_TASK_STACK + i] = (uint32_t)uxTaskGetStackHighWaterMark(monitor->tasks[i]);
+	}
+#endif
+}
+
+#endif /* MEMORY_MONITOR_H_ */
@@ -0,0 +1,298 @@
+#ifndef MESSAGE_MEMORY_H_
+#define MESSAGE_MEMORY_H_
+
+// Static message memory planner.
+//
+// Walks the rosidl introspection of a message type and gives every
+// string and sequence in it, nested messages included, a buffer carved
+// out of one caller-provided arena. message_memory_size() returns the
+// exact number of bytes a layout needs, message_memory_init() lays it out
+// in one call. Buffers follow the member order of the message, so a
+// received message is deserialized into one contiguous block, and nothing
+// touches the heap.
+//
+// Capacities come from the bounds: a bounded sequence or string gets its
+// bound, anything else the defaults, which rules can override per member.
+// A rule is matched by the dotted member path ("header.frame_id", "name")
+// and sets the element capacity of a sequence, the byte capacity of a
+// string (terminator included), or both for a sequence of strings:
+//   static const message_memory_rule_t rules[] = {
+//     {"header.frame_id", 0, 32},
+//     {"name", 20, 32},       // 20 names of up to 31 characters
+//   };
+//
+// The type support has to be the introspection one:
+//   MESSAGE_MEMORY_TYPE_SUPPORT(sensor_msgs, msg, JointState)
+//
+// The same walk gives message_memory_serialized_size(), the CDR size of a
+// message with every string and sequence at its capacity. That is the
+// largest message the layout can receive, and what the XRCE input stream
+// has to be able to reassemble (see xrce_fragments.h).
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <rosidl_runtime_c/message_type_support_struct.h>
+#include <rosidl_runtime_c/string.h>
+#include <rosidl_runtime_c/u16string.h>
+#include <rosidl_typesupport_introspection_c/field_types.h>
+#include <rosidl_typesupport_introspection_c/identifier.h>
+#include <rosidl_typesupport_introspection_c/message_introspection.h>
+
+// Needs <pkg>/msg/detail/<type>__rosidl_typesupport_introspection_c.h
+#define MESSAGE_MEMORY_TYPE_SUPPORT(pkg, msg, type) \
+	ROSIDL_TYPESUPPORT_INTERFACE__MESSAGE_SYMBOL_NAME(rosidl_typesupport_introspection_c, pkg, msg, type)()
+
+// Every buffer starts on this boundary, enough for any primitive
+#define MESSAGE_MEMORY_ALIGN 8
+
+#ifndef MESSAGE_MEMORY_MAX_PATH
+#define MESSAGE_MEMORY_MAX_PATH 64
+#endif
+
+typedef struct message_memory_rule_t {
+	const char * path;
+	size_t sequence_capacity;   // 0: default
+	size_t string_capacity;     // 0: default
+} message_memory_rule_t;
+
+typedef struct message_memory_bounds_t {
+	size_t sequence_capacity;
+	size_t string_capacity;
+	const message_memory_rule_t * rules;
+	size_t rule_count;
+} message_memory_bounds_t;
+
+// All sequences share this layout, whatever their element type
+typedef struct message_memory_sequence_t {
+	void * data;
+	size_t size;
+	size_t capacity;
+} message_memory_sequence_t;
+
+typedef struct message_memory_layout_t {
+	size_t bytes;
+	size_t serialized;          // CDR bytes of the message at full capacity
+	uint32_t sequences;
+	uint32_t strings;
+} message_memory_layout_t;
+
+typedef struct message_memory_cursor_t {
+	uint8_t * arena;            // NULL while only measuring
+	size_t used;
+	size_t size;
+	message_memory_layout_t layout;
+	char path[MESSAGE_MEMORY_MAX_PATH];
+} message_memory_cursor_t;
+
+static inline const rosidl_typesupport_introspection_c__MessageMembers * message_memory_members(
+	const rosidl_message_type_support_t * type_support)
+{
+	const rosidl_message_type_support_t * introspection =
+		get_message_typesupport_handle(type_support, rosidl_typesupport_introspection_c__identifier);
+
+	return (introspection != NULL) ?
+		(const rosidl_typesupport_introspection_c__MessageMembers *)introspection->data : NULL;
+}
+
+// CDR size, and alignment, of a primitive member; 0 for strings and messages
+static inline size_t message_memory_primitive_size(uint8_t type_id)
+{
+	switch (type_id) {
+		case rosidl_typesupport_introspection_c__ROS_TYPE_LONG_DOUBLE:
+			return 16;
+		case rosidl_typesupport_introspection_c__ROS_TYPE_DOUBLE:
+		case rosidl_typesupport_introspection_c__ROS_TYPE_UINT64:
+		case rosidl_typesupport_introspection_c__ROS_TYPE_INT64:
+			return 8;
+		case rosidl_typesupport_introspection_c__ROS_TYPE_FLOAT:
+		case rosidl_typesupport_introspection_c__ROS_TYPE_UINT32:
+		case rosidl_typesupport_introspection_c__ROS_TYPE_INT32:
+			return 4;
+		case rosidl_typesupport_introspection_c__ROS_TYPE_WCHAR:
+		case rosidl_typesupport_introspection_c__ROS_TYPE_UINT16:
+		case rosidl_typesupport_introspection_c__ROS_TYPE_INT16:
+			return 2;
+		case rosidl_typesupport_introspection_c__ROS_TYPE_STRING:
+		case rosidl_typesupport_introspection_c__ROS_TYPE_WSTRING:
+		case rosidl_typesupport_introspection_c__ROS_TYPE_MESSAGE:
+			return 0;
+		default:
+			return 1;
+	}
+}
+
+// Advances the serialized size by 'bytes' aligned to 'align', as CDR does
+static inline void message_memory_serialize(message_memory_cursor_t * cursor, size_t align, size_t bytes)
+{
+	cursor->layout.serialized = (cursor->layout.serialized + align - 1) / align * align + bytes;
+}
+
+static inline const message_memory_rule_t * message_memory_rule(const message_memory_bounds_t * bounds, const char * path)
+{
+	for (size_t i = 0; i < bounds->rule_count; i++) {
+		if (strcmp(bounds->rules[i].path, path) == 0) {
+			return &bounds->rules[i];
+		}
+	}
+	return NULL;
+}
+
+// Reserves 'bytes' and returns them, or NULL when measuring or out of arena
+static inline void * message_memory_take(message_memory_cursor_t * cursor, size_t bytes)
+{
+	size_t start = (cursor->used + MESSAGE_MEMORY_ALIGN - 1) & ~(size_t)(MESSAGE_MEMORY_ALIGN - 1);
+
+	cursor->used = start + bytes;
+	if (cursor->arena == NULL || cursor->used > cursor->size) {
+		return NULL;
+	}
+	return &cursor->arena[start];
+}
+
+static inline void message_memory_string(message_memory_cursor_t * cursor, const rosidl_typesupport_introspection_c__MessageMember * member,
+	const message_memory_rule_t * rule, const message_memory_bounds_t * bounds, void * field)
+{
+	size_t capacity = bounds->string_capacity;
+	if (member->string_upper_bound_ > 0) {
+		capacity = member->string_upper_bound_ + 1;
+	} else if (rule != NULL && rule->string_capacity > 0) {
+		capacity = rule->string_capacity;
+	}
+
+	size_t char_size = (member->type_id_ == rosidl_typesupport_introspection_c__ROS_TYPE_WSTRING) ? sizeof(uint16_t) : 1;
+	void * data = message_memory_take(cursor, capacity * char_size);
+	cursor->layout.strings++;
+	// Length, then the characters including the terminator
+	message_memory_serialize(cursor, 4, 4 + capacity * char_size);
+
+	if (field != NULL) {
+		// rosidl_runtime_c__String and __U16String only differ in the element type
+		rosidl_runtime_c__String * string = (rosidl_runtime_c__String *)field;
+		string->data = (char *)data;
+		string->size = 0;
+		string->capacity = (data != NULL) ? capacity : 0;
+	}
+}
+
+static inline void message_memory_walk(message_memory_cursor_t * cursor,
+	const rosidl_typesupport_introspection_c__MessageMembers * members, const message_memory_bounds_t * bounds, void * msg);
+
+// Lays out one field, a single value or every element of a fixed array
+static inline void message_memory_value(message_memory_cursor_t * cursor, const rosidl_typesupport_introspection_c__MessageMember * member,
+	const message_memory_rule_t * rule, const message_memory_bounds_t * bounds, void * field)
+{
+	if (member->type_id_ == rosidl_typesupport_introspection_c__ROS_TYPE_STRING ||
+		member->type_id_ == rosidl_typesupport_introspection_c__ROS_TYPE_WSTRING) {
+		message_memory_string(cursor, member, rule, bounds, field);
+	} else if (member->type_id_ == rosidl_typesupport_introspection_c__ROS_TYPE_MESSAGE) {
+		message_memory_walk(cursor, message_memory_members(member->members_), bounds, field);
+	} else {
+		size_t size = message_memory_primitive_size(member->type_id_);
+		message_memory_serialize(cursor, size, size);
+	}
+}
+
+static inline void message_memory_walk(message_memory_cursor_t * cursor,
+	const rosidl_typesupport_introspection_c__MessageMembers * members, const message_memory_bounds_t * bounds, void * msg)
+{
+	if (members == NULL) {
+		return;
+	}
+
+	size_t path_length = strlen(cursor->path);
+
+	for (uint32_t i = 0; i < members->member_count_; i++) {
+		const rosidl_typesupport_introspection_c__MessageMember * member = &members->members_[i];
+		uint8_t * field = (msg != NULL) ? (uint8_t *)msg + member->offset_ : NULL;
+
+		snprintf(&cursor->path[path_length], MESSAGE_MEMORY_MAX_PATH - path_length,
+			path_length > 0 ? ".%s" : "%s", member->name_);
+		const message_memory_rule_t * rule = message_memory_rule(bounds, cursor->path);
+
+		if (!member->is_array_) {
+			message_memory_value(cursor, member, rule, bounds, field);
+		} else if (member->array_size_ > 0 && !member->is_upper_bound_) {
+			// Fixed array: the elements live in the message itself
+			for (size_t e = 0; e < member->array_size_; e++) {
+				message_memory_value(cursor, member, rule, bounds, field != NULL ? field + e * member->size_of_ : NULL);
+			}
+		} else {
+			size_t capacity = bounds->sequence_capacity;
+			if (member->is_upper_bound_) {
+				capacity = member->array_size_;
+			} else if (rule != NULL && rule->sequence_capacity > 0) {
+				capacity = rule->sequence_capacity;
+			}
+
+			uint8_t * data = (uint8_t *)message_memory_take(cursor, capacity * member->size_of_);
+			cursor->layout.sequences++;
+			message_memory_serialize(cursor, 4, 4);
+
+			if (field != NULL) {
+				message_memory_sequence_t * sequence = (message_memory_sequence_t *)field;
+				sequence->data = data;
+				sequence->size = 0;
+				sequence->capacity = (data != NULL) ? capacity : 0;
+			}
+
+			// Strings and messages in the sequence get their own buffers right after it
+			for (size_t e = 0; e < capacity; e++) {
+				message_memory_value(cursor, member, rule, bounds, data != NULL ? data + e * member->size_of_ : NULL);
+			}
+		}
+	}
+
+	cursor->path[path_length] = '\0';
+}
+
+static inline message_memory_layout_t message_memory_plan(const rosidl_message_type_support_t * type_support,
+	const message_memory_bounds_t * bounds, void * msg, uint8_t * arena, size_t arena_size)
+{
+	message_memory_cursor_t cursor;
+
+	cursor.arena = arena;
+	cursor.used = 0;
+	cursor.size = arena_size;
+	cursor.layout.serialized = 0;
+	cursor.layout.sequences = 0;
+	cursor.layout.strings = 0;
+	cursor.path[0] = '\0';
+
+	message_memory_walk(&cursor, message_memory_members(type_support), bounds, msg);
+
+	cursor.layout.bytes = cursor.used;
+	return cursor.layout;
+}
+
+// Arena bytes needed by the layout, 0 if 'type_support' is not an introspection type support
+static inline size_t message_memory_size(const rosidl_message_type_support_t * type_support, const message_memory_bounds_t * bounds)
+{
+	return message_memory_plan(type_support, bounds, NULL, NULL, 0).bytes;
+}
+
+// CDR bytes of the largest message the layout holds, 0 if 'type_support' is
+// not an introspection type support
+static inline size_t message_memory_serialized_size(const rosidl_message_type_support_t * type_support,
+	const message_memory_bounds_t * bounds)
+{
+	return message_memory_plan(type_support, bounds, NULL, NULL, 0).serialized;
+}
+
+// Points every string and sequence of 'msg' into 'arena', all sizes 0. Fails,
+// leaving 'msg' partly laid out, when the arena is too small.
+static inline bool message_memory_init(const rosidl_message_type_support_t * type_support, const message_memory_bounds_t * bounds,
+	void * msg, uint8_t * arena, size_t arena_size)
+{
+	if (message_memory_members(type_support) == NULL) {
+		return false;
+	}
+
+	memset(arena, 0, arena_size);
+	return message_memory_plan(type_support, bounds, msg, arena, arena_size).bytes <= arena_size;
+}
+
+#endif /* MESSAGE_MEMORY_H_ */
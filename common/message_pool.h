@@ -0,0 +1,123 @@
+#ifndef MESSAGE_POOL_H_
+#define MESSAGE_POOL_H_
+
+// Fixed-capacity message buffer pool.
+//
+// MESSAGE_POOL_BLOCKS buffers of MESSAGE_POOL_BLOCK_SIZE bytes are reserved
+// statically, so handing out message memory never touches the heap and heap
+// use stays flat for the lifetime of the app. Acquire and release are
+// lock-free (one atomic bitmap), which makes them safe to use from several
+// tasks, and the pool keeps high-water statistics for sizing.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include <rosidl_runtime_c/string.h>
+
+#ifndef MESSAGE_POOL_BLOCKS
+#define MESSAGE_POOL_BLOCKS 8
+#endif
+
+#ifndef MESSAGE_POOL_BLOCK_SIZE
+#define MESSAGE_POOL_BLOCK_SIZE 64
+#endif
+
+#if MESSAGE_POOL_BLOCKS > 32
+#error "MESSAGE_POOL_BLOCKS must fit in the 32-bit free mask"
+#endif
+
+#define MESSAGE_POOL_ALL_FREE \
+	((MESSAGE_POOL_BLOCKS == 32) ? 0xFFFFFFFFu : ((1u << MESSAGE_POOL_BLOCKS) - 1))
+
+typedef struct message_pool_stats_t {
+	uint32_t in_use;
+	uint32_t high_water;
+	uint32_t acquired;
+	uint32_t failed;
+} message_pool_stats_t;
+
+static uint8_t message_pool_storage[MESSAGE_POOL_BLOCKS][MESSAGE_POOL_BLOCK_SIZE] __attribute__((aligned(8)));
+static uint32_t message_pool_free_mask = MESSAGE_POOL_ALL_FREE;
+static message_pool_stats_t message_pool_stats;
+
+// Returns a MESSAGE_POOL_BLOCK_SIZE buffer, or NULL if every block is in use
+static inline void * message_pool_acquire(void)
+{
+	uint32_t mask = __atomic_load_n(&message_pool_free_mask, __ATOMIC_ACQUIRE);
+
+	while (mask != 0) {
+		uint32_t bit = mask & (~mask + 1);
+		if (__atomic_compare_exchange_n(&message_pool_free_mask, &mask, mask & ~bit,
+			false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+		{
+			uint32_t in_use = __atomic_add_fetch(&message_pool_stats.in_use, 1, __ATOMIC_RELAXED);
+			uint32_t high_water = __atomic_load_n(&message_pool_stats.high_water, __ATOMIC_RELAXED);
+			while (in_use > high_water &&
+				!__atomic_compare_exchange_n(&message_pool_stats.high_water, &high_water, in_use,
+					false, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+			{
+			}
+			__atomic_add_fetch(&message_pool_stats.acquired, 1, __ATOMIC_RELAXED);
+			return message_pool_storage[__builtin_ctz(bit)];
+		}
+		// 'mask' was reloaded by the failed exchange, try again
+	}
+
+	__atomic_add_fetch(&message_pool_stats.failed, 1, __ATOMIC_RELAXED);
+	return NULL;
+}
+
+static inline void message_pool_release(void * block)
+{
+	if (block == NULL) {
+		return;
+	}
+
+	size_t index = (size_t)((uint8_t *)block - &message_pool_storage[0][0]) / MESSAGE_POOL_BLOCK_SIZE;
+	if (index >= MESSAGE_POOL_BLOCKS || block != message_pool_storage[index]) {
+		return;
+	}
+
+	// A block that is already free was released twice: leave the count alone
+	uint32_t previous = __atomic_fetch_or(&message_pool_free_mask, 1u << index, __ATOMIC_RELEASE);
+	if ((previous & (1u << index)) != 0) {
+		return;
+	}
+	__atomic_sub_fetch(&message_pool_stats.in_use, 1, __ATOMIC_RELAXED);
+}
+
+// Points an empty string message field at a pool block
+static inline bool message_pool_acquire_string(rosidl_runtime_c__String * str)
+{
+	char * block = (char *)message_pool_acquire();
+	if (block == NULL) {
+		return false;
+	}
+
+	block[0] = '\0';
+	str->data = block;
+	str->size = 0;
+	str->capacity = MESSAGE_POOL_BLOCK_SIZE;
+	return true;
+}
+
+static inline void message_pool_release_string(rosidl_runtime_c__String * str)
+{
+	message_pool_release(str->data);
+	str->data = NULL;
+	str->size = 0;
+	str->capacity = 0;
+}
+
+static inline message_pool_stats_t message_pool_get_stats(void)
+{
+	message_pool_stats_t stats;
+	stats.in_use = __atomic_load_n(&message_pool_stats.in_use, __ATOMIC_RELAXED);
+	stats.high_water = __atomic_load_n(&message_pool_stats.high_water, __ATOMIC_RELAXED);
+	stats.acquired = __atomic_load_n(&message_pool_stats.acquired, __ATOMIC_RELAXED);
+	stats.failed = __atomic_load_n(&message_pool_stats.failed, __ATOMIC_RELAXED);
+	return stats;
+}
+
+#endif /* MESSAGE_POOL_H_ */
@@ -0,0 +1,176 @@
+#ifndef PERIODIC_RUNNER_H_
+#define PERIODIC_RUNNER_H_
+
+// Absolute-deadline periodic runner for fixed-rate loops.
+//
+// Sleeping a fixed time after the work makes the real period "period plus
+// work time", and the error accumulates. The runner keeps a grid of
+// release times, start + n * period, and sleeps until the next point on
+// it: vTaskDelayUntil() on FreeRTOS, clock_nanosleep(TIMER_ABSTIME) on
+// POSIX. A cycle whose work runs past one or more release points counts
+// as an overrun, and the missed points are skipped rather than run back
+// to back.
+//
+// Per cycle it records the wake-up jitter (actual minus planned release)
+// and the execution time, the latter in a latency histogram to get the
+// worst case and percentiles. periodic_runner_diagnostics() flattens the
+// statistics for a UInt32MultiArray diagnostics topic.
+//
+// On FreeRTOS the runner sleeps on the tick grid, which need not line up
+// with PERIODIC_RUNNER_NOW_US(). The microsecond grid is therefore anchored
+// to the first tick-aligned wake-up, and its period is the tick-rounded
+// one, so the sub-tick offset between the two clocks does not show up as
+// jitter in every cycle.
+//
+// Timestamps come from PERIODIC_RUNNER_NOW_US(), which defaults to
+// esp_timer_get_time() on ESP32, the tick count on other FreeRTOS ports
+// and CLOCK_MONOTONIC on POSIX. Define it before including this header
+// to use a finer clock, e.g. usecTimestamp() on the Crazyflie.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <time.h>
+
+#include "latency_histogram.h"
+
+#ifndef PERIODIC_RUNNER_NOW_US
+#if defined(ESP_PLATFORM)
+#include "esp_timer.h"
+#define PERIODIC_RUNNER_NOW_US() ((uint64_t)esp_timer_get_time())
+#elif defined(INC_FREERTOS_H)
+#define PERIODIC_RUNNER_NOW_US() ((uint64_t)xTaskGetTickCount() * portTICK_PERIOD_MS * 1000)
+#else
+static inline uint64_t periodic_runner_monotonic_us(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+#define PERIODIC_RUNNER_NOW_US() periodic_runner_monotonic_us()
+#endif
+#endif
+
+// Layout of periodic_runner_diagnostics()
+#define PERIODIC_RUNNER_DIAG_CYCLES 0
+#define PERIODIC_RUNNER_DIAG_OVERRUNS 1
+#define PERIODIC_RUNNER_DIAG_JITTER_MEAN_US 2
+#define PERIODIC_RUNNER_DIAG_JITTER_MAX_US 3
+#define PERIODIC_RUNNER_DIAG_EXEC_P50_US 4
+#define PERIODIC_RUNNER_DIAG_EXEC_P99_US 5
+#define PERIODIC_RUNNER_DIAG_EXEC_MAX_US 6
+#define PERIODIC_RUNNER_DIAG_FIELDS 7
+
+typedef struct periodic_runner_t {
+	uint32_t period_us;
+#ifdef INC_FREERTOS_H
+	TickType_t last_wake;
+	TickType_t period_ticks;
+#else
+	struct timespec deadline;
+#endif
+	uint64_t release_us;
+	uint64_t cycle_start_us;
+	bool started;
+	// Statistics
+	uint32_t cycles;
+	uint32_t overruns;
+	uint64_t jitter_sum_us;
+	uint32_t jitter_max_us;
+	latency_histogram_t exec_us;
+} periodic_runner_t;
+
+static inline void periodic_runner_reset_stats(periodic_runner_t * runner)
+{
+	runner->cycles = 0;
+	runner->overruns = 0;
+	runner->jitter_sum_us = 0;
+	runner->jitter_max_us = 0;
+	latency_histogram_reset(&runner->exec_us);
+}
+
+// The first release happens one period after init
+static inline void periodic_runner_init(periodic_runner_t * runner, uint32_t period_ms)
+{
+	runner->period_us = period_ms * 1000;
+#ifdef INC_FREERTOS_H
+	runner->period_ticks = period_ms / portTICK_PERIOD_MS;
+	if (runner->period_ticks == 0) {
+		runner->period_ticks = 1;
+	}
+	runner->period_us = runner->period_ticks * portTICK_PERIOD_MS * 1000;
+	runner->last_wake = xTaskGetTickCount();
+#else
+	clock_gettime(CLOCK_MONOTONIC, &runner->deadline);
+#endif
+	runner->release_us = PERIODIC_RUNNER_NOW_US();
+	runner->cycle_start_us = runner->release_us;
+	runner->started = false;
+	periodic_runner_reset_stats(runner);
+}
+
+// Ends the current cycle and sleeps until the next release point
+static inline void periodic_runner_wait(periodic_runner_t * runner)
+{
+	uint64_t now = PERIODIC_RUNNER_NOW_US();
+	uint32_t skipped = 0;
+
+	if (runner->started) {
+		uint64_t exec = now - runner->cycle_start_us;
+		latency_histogram_record(&runner->exec_us, exec > UINT32_MAX ? UINT32_MAX : (uint32_t)exec);
+	}
+
+	// Release points already behind us were missed by the work of this cycle
+	while (now >= runner->release_us + (uint64_t)runner->period_us * (skipped + 1)) {
+		skipped++;
+	}
+	if (runner->started && skipped > 0) {
+		runner->overruns++;
+	}
+	runner->release_us += (uint64_t)runner->period_us * (skipped + 1);
+
+#ifdef INC_FREERTOS_H
+	runner->last_wake += runner->period_ticks * skipped;
+	vTaskDelayUntil(&runner->last_wake, runner->period_ticks);
+#else
+	uint64_t advance_ns = (uint64_t)runner->period_us * 1000 * (skipped + 1);
+	runner->deadline.tv_sec += (time_t)(advance_ns / 1000000000);
+	runner->deadline.tv_nsec += (long)(advance_ns % 1000000000);
+	if (runner->deadline.tv_nsec >= 1000000000) {
+		runner->deadline.tv_sec++;
+		runner->deadline.tv_nsec -= 1000000000;
+	}
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &runner->deadline, NULL) != 0) {
+		// interrupted by a signal, sleep again until the same deadline
+	}
+#endif
+
+	runner->cycle_start_us = PERIODIC_RUNNER_NOW_US();
+#ifdef INC_FREERTOS_H
+	if (!runner->started) {
+		// First wake on the tick grid: the release grid starts here
+		runner->release_us = runner->cycle_start_us;
+	}
+#endif
+	uint64_t jitter = runner->cycle_start_us > runner->release_us ? runner->cycle_start_us - runner->release_us : 0;
+	runner->jitter_sum_us += jitter;
+	if (jitter > runner->jitter_max_us) {
+		runner->jitter_max_us = jitter > UINT32_MAX ? UINT32_MAX : (uint32_t)jitter;
+	}
+	runner->cycles++;
+	runner->started = true;
+}
+
+// Fills 'out' with PERIODIC_RUNNER_DIAG_FIELDS values, see the layout above
+static inline void periodic_runner_diagnostics(const periodic_runner_t * runner, uint32_t * out)
+{
+	out[PERIODIC_RUNNER_DIAG_CYCLES] = runner->cycles;
+	out[PERIODIC_RUNNER_DIAG_OVERRUNS] = runner->overruns;
+	out[PERIODIC_RUNNER_DIAG_JITTER_MEAN_US] = runner->cycles ? (uint32_t)(runner->jitter_sum_us / runner->cycles) : 0;
+	out[PERIODIC_RUNNER_DIAG_JITTER_MAX_US] = runner->jitter_max_us;
+	out[PERIODIC_RUNNER_DIAG_EXEC_P50_US] = latency_histogram_percentile(&runner->exec_us, 500);
+	out[PERIODIC_RUNNER_DIAG_EXEC_P99_US] = latency_histogram_percentile(&runner->exec_us, 990);
+	out[PERIODIC_RUNNER_DIAG_EXEC_MAX_US] = runner->exec_us.max;
+}
+
+#endif /* PERIODIC_RUNNER_H_ */
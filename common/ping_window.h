@@ -0,0 +1,130 @@
+#ifndef PING_WINDOW_H_
+#define PING_WINDOW_H_
+
+// Window of in-flight pings for the ping_pong apps.
+//
+// Every ping gets a binary sequence number. The ping frame_id carries the
+// sender device id and that sequence number as fixed-width hex, so a pong is
+// matched by decoding 16 characters and indexing the ring with
+// seq & (PING_WINDOW_SIZE - 1): no sprintf and no strcmp on the hot path.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Number of pings that can be in flight at the same time (power of two)
+#ifndef PING_WINDOW_SIZE
+#define PING_WINDOW_SIZE 8
+#endif
+
+#if (PING_WINDOW_SIZE & (PING_WINDOW_SIZE - 1)) != 0
+#error "PING_WINDOW_SIZE must be a power of two"
+#endif
+
+// frame_id layout: 8 hex digits of device id followed by 8 hex digits of seq
+#define PING_FRAME_ID_LEN 16
+
+typedef struct ping_slot_t {
+	uint32_t seq;
+	uint32_t pong_count;
+	bool in_flight;
+} ping_slot_t;
+
+typedef struct ping_window_t {
+	ping_slot_t slots[PING_WINDOW_SIZE];
+	uint32_t next_seq;
+	uint32_t sent;
+	uint32_t unanswered;
+	uint32_t late_pongs;
+} ping_window_t;
+
+static inline void ping_window_init(ping_window_t * window, uint32_t first_seq)
+{
+	for (unsigned int i = 0; i < PING_WINDOW_SIZE; i++) {
+		window->slots[i].seq = 0;
+		window->slots[i].pong_count = 0;
+		window->slots[i].in_flight = false;
+	}
+	window->next_seq = first_seq;
+	window->sent = 0;
+	window->unanswered = 0;
+	window->late_pongs = 0;
+}
+
+// Claims the slot for the next sequence number. The ping that used the slot
+// PING_WINDOW_SIZE pings ago is retired, and counted if nobody answered it.
+static inline ping_slot_t * ping_window_open(ping_window_t * window)
+{
+	uint32_t seq = window->next_seq++;
+	ping_slot_t * slot = &window->slots[seq & (PING_WINDOW_SIZE - 1)];
+
+	if (slot->in_flight && slot->pong_count == 0) {
+		window->unanswered++;
+	}
+
+	slot->seq = seq;
+	slot->pong_count = 0;
+	slot->in_flight = true;
+	window->sent++;
+
+	return slot;
+}
+
+// Returns the in-flight slot for 'seq', or NULL if that ping already left the window
+static inline ping_slot_t * ping_window_match(ping_window_t * window, uint32_t seq)
+{
+	ping_slot_t * slot = &window->slots[seq & (PING_WINDOW_SIZE - 1)];
+
+	if (!slot->in_flight || slot->seq != seq) {
+		window->late_pongs++;
+		return NULL;
+	}
+
+	return slot;
+}
+
+static inline void ping_hex_encode(char * buffer, uint32_t value)
+{
+	static const char digits[16] = "0123456789abcdef";
+	for (int i = 7; i >= 0; i--) {
+		buffer[i] = digits[value & 0xF];
+		value >>= 4;
+	}
+}
+
+static inline bool ping_hex_decode(const char * buffer, uint32_t * value)
+{
+	uint32_t out = 0;
+	for (int i = 0; i < 8; i++) {
+		char c = buffer[i];
+		uint32_t nibble;
+		if (c >= '0' && c <= '9') {
+			nibble = (uint32_t)(c - '0');
+		} else if (c >= 'a' && c <= 'f') {
+			nibble = (uint32_t)(c - 'a' + 10);
+		} else {
+			return false;
+		}
+		out = (out << 4) | nibble;
+	}
+	*value = out;
+	return true;
+}
+
+// Writes PING_FRAME_ID_LEN characters plus a terminating NUL
+static inline void ping_frame_id_encode(char * buffer, uint32_t device_id, uint32_t seq)
+{
+	ping_hex_encode(buffer, device_id);
+	ping_hex_encode(buffer + 8, seq);
+	buffer[PING_FRAME_ID_LEN] = '\0';
+}
+
+static inline bool ping_frame_id_decode(const char * data, size_t size, uint32_t * device_id, uint32_t * seq)
+{
+	if (data == NULL || size != PING_FRAME_ID_LEN) {
+		return false;
+	}
+	return ping_hex_decode(data, device_id) && ping_hex_decode(data + 8, seq);
+}
+
+#endif /* PING_WINDOW_H_ */
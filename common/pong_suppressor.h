@@ -0,0 +1,133 @@
+#ifndef PONG_SUPPRESSOR_H_
+#define PONG_SUPPRESSOR_H_
+
+// Pong-storm suppression for the ping_pong apps.
+//
+// In PONG_MODE_ALWAYS every device answers every ping immediately, so a fleet
+// of N devices produces N-1 pongs per ping and O(N^2) traffic per round.
+// In PONG_MODE_BACKOFF a device delays its pong by a random backoff and
+// cancels it once it has heard PONG_QUORUM pongs for the same ping from its
+// peers, so each ping costs roughly 1 + PONG_QUORUM messages.
+//
+// A delayed pong still echoes the ping stamp, from which the pinger computes
+// the round trip. The caller shifts that stamp forward by the time the pong
+// was held, now minus pong_pending_t::received_us, so the backoff does not
+// show up as round-trip time.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#define PONG_MODE_ALWAYS 0
+#define PONG_MODE_BACKOFF 1
+
+// Pongs that can wait for their backoff at the same time
+#ifndef PONG_PENDING_MAX
+#define PONG_PENDING_MAX 8
+#endif
+
+typedef struct pong_pending_t {
+	uint32_t sender_id;
+	uint32_t seq;
+	int32_t stamp_sec;
+	uint32_t stamp_nanosec;
+	int64_t received_us;
+	int64_t due_us;
+	uint32_t heard;
+	bool active;
+} pong_pending_t;
+
+typedef struct pong_suppressor_stats_t {
+	uint32_t pings;
+	uint32_t sent;
+	uint32_t cancelled;
+	uint32_t overflow;
+} pong_suppressor_stats_t;
+
+typedef struct pong_suppressor_t {
+	int mode;
+	uint32_t quorum;
+	uint32_t backoff_max_ms;
+	pong_pending_t pending[PONG_PENDING_MAX];
+	pong_suppressor_stats_t stats;
+} pong_suppressor_t;
+
+static inline void pong_suppressor_init(pong_suppressor_t * suppressor, int mode, uint32_t quorum, uint32_t backoff_max_ms)
+{
+	suppressor->mode = mode;
+	suppressor->quorum = quorum;
+	suppressor->backoff_max_ms = backoff_max_ms;
+	for (unsigned int i = 0; i < PONG_PENDING_MAX; i++) {
+		suppressor->pending[i].active = false;
+	}
+	suppressor->stats.pings = 0;
+	suppressor->stats.sent = 0;
+	suppressor->stats.cancelled = 0;
+	suppressor->stats.overflow = 0;
+}
+
+// Called for every ping heard from a peer. Returns true if the pong must be
+// sent right away; otherwise it has been scheduled and will be returned by
+// pong_suppressor_next_due() unless enough peers answer first.
+static inline bool pong_suppressor_on_ping(pong_suppressor_t * suppressor,
+	uint32_t sender_id, uint32_t seq, int32_t stamp_sec, uint32_t stamp_nanosec, int64_t now_us)
+{
+	suppressor->stats.pings++;
+
+	if (suppressor->mode == PONG_MODE_ALWAYS) {
+		suppressor->stats.sent++;
+		return true;
+	}
+
+	for (unsigned int i = 0; i < PONG_PENDING_MAX; i++) {
+		pong_pending_t * entry = &suppressor->pending[i];
+		if (!entry->active) {
+			entry->sender_id = sender_id;
+			entry->seq = seq;
+			entry->stamp_sec = stamp_sec;
+			entry->stamp_nanosec = stamp_nanosec;
+			entry->received_us = now_us;
+			entry->due_us = now_us + (int64_t)(rand() % (suppressor->backoff_max_ms + 1)) * 1000;
+			entry->heard = 0;
+			entry->active = true;
+			return false;
+		}
+	}
+
+	// No room to wait: answer now rather than stay silent
+	suppressor->stats.overflow++;
+	suppressor->stats.sent++;
+	return true;
+}
+
+// Called for every pong heard from a peer
+static inline void pong_suppressor_on_pong(pong_suppressor_t * suppressor, uint32_t sender_id, uint32_t seq)
+{
+	for (unsigned int i = 0; i < PONG_PENDING_MAX; i++) {
+		pong_pending_t * entry = &suppressor->pending[i];
+		if (entry->active && entry->sender_id == sender_id && entry->seq == seq) {
+			if (++entry->heard >= suppressor->quorum) {
+				entry->active = false;
+				suppressor->stats.cancelled++;
+			}
+			return;
+		}
+	}
+}
+
+// Returns a pong whose backoff expired, or NULL. The entry is released, so
+// the caller must copy what it needs before the next call.
+static inline const pong_pending_t * pong_suppressor_next_due(pong_suppressor_t * suppressor, int64_t now_us)
+{
+	for (unsigned int i = 0; i < PONG_PENDING_MAX; i++) {
+		pong_pending_t * entry = &suppressor->pending[i];
+		if (entry->active && entry->due_us <= now_us) {
+			entry->active = false;
+			suppressor->stats.sent++;
+			return entry;
+		}
+	}
+	return NULL;
+}
+
+#endif /* PONG_SUPPRESSOR_H_ */
@@ -0,0 +1,342 @@
+#ifndef POOL_ALLOCATOR_H_
+#define POOL_ALLOCATOR_H_
+
+// Arena + size-class pool allocator for micro-ROS.
+//
+// All memory comes from one static arena of POOL_ALLOCATOR_ARENA_SIZE bytes.
+// Requests are rounded up to a power-of-two size class; freed blocks go to
+// the free list of their class and are reused by the next request of that
+// class, while fresh blocks are bump-allocated from the arena. Allocation
+// and release are therefore O(1), blocks never fragment the arena, and an
+// exhausted arena fails immediately instead of falling back to the heap.
+//
+// Usage is accounted per tag. pool_allocator_install() replaces the rcutils
+// default allocator, which charges the tag set by pool_allocator_set_tag();
+// pool_allocator_get(tag) returns an allocator that always charges 'tag'.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+
+#include <rcutils/allocator.h>
+
+#ifndef POOL_ALLOCATOR_ARENA_SIZE
+#define POOL_ALLOCATOR_ARENA_SIZE 16384
+#endif
+
+// Size classes are 2^MIN_SHIFT .. 2^MAX_SHIFT bytes, block header included
+#ifndef POOL_ALLOCATOR_MIN_SHIFT
+#define POOL_ALLOCATOR_MIN_SHIFT 4
+#endif
+
+#ifndef POOL_ALLOCATOR_MAX_SHIFT
+#define POOL_ALLOCATOR_MAX_SHIFT 12
+#endif
+
+#ifndef POOL_ALLOCATOR_PRINTF
+#define POOL_ALLOCATOR_PRINTF printf
+#endif
+
+#define POOL_ALLOCATOR_CLASSES (POOL_ALLOCATOR_MAX_SHIFT - POOL_ALLOCATOR_MIN_SHIFT + 1)
+#define POOL_ALLOCATOR_HEADER 8
+#define POOL_ALLOCATOR_MAGIC 0xA5
+
+// Critical section around the free lists and the bump pointer
+#if defined(ESP_PLATFORM)
+static portMUX_TYPE pool_allocator_mux = portMUX_INITIALIZER_UNLOCKED;
+#define POOL_ALLOCATOR_LOCK() portENTER_CRITICAL(&pool_allocator_mux)
+#define POOL_ALLOCATOR_UNLOCK() portEXIT_CRITICAL(&pool_allocator_mux)
+#elif defined(INC_FREERTOS_H)
+#define POOL_ALLOCATOR_LOCK() taskENTER_CRITICAL()
+#define POOL_ALLOCATOR_UNLOCK() taskEXIT_CRITICAL()
+#elif defined(__unix__)
+#include <pthread.h>
+static pthread_mutex_t pool_allocator_mutex = PTHREAD_MUTEX_INITIALIZER;
+#define POOL_ALLOCATOR_LOCK() pthread_mutex_lock(&pool_allocator_mutex)
+#define POOL_ALLOCATOR_UNLOCK() pthread_mutex_unlock(&pool_allocator_mutex)
+#else
+#define POOL_ALLOCATOR_LOCK()
+#define POOL_ALLOCATOR_UNLOCK()
+#endif
+
+typedef enum pool_allocator_tag_t {
+	POOL_TAG_RMW = 0,
+	POOL_TAG_NODE,
+	POOL_TAG_EXECUTOR,
+	POOL_TAG_MESSAGES,
+	POOL_TAG_OTHER,
+	POOL_TAG_COUNT
+} pool_allocator_tag_t;
+
+typedef struct pool_allocator_tag_stats_t {
+	uint32_t bytes;
+	uint32_t peak_bytes;
+	uint32_t allocations;
+	uint32_t frees;
+	uint32_t failures;
+} pool_allocator_tag_stats_t;
+
+// Lives in the 8 bytes in front of every block
+typedef struct pool_allocator_header_t {
+	uint8_t magic;
+	uint8_t size_class;
+	uint8_t tag;
+	uint8_t reserved;
+	uint32_t size;
+} pool_allocator_header_t;
+
+typedef struct pool_allocator_free_t {
+	struct pool_allocator_free_t * next;
+} pool_allocator_free_t;
+
+static uint8_t pool_allocator_arena[POOL_ALLOCATOR_ARENA_SIZE] __attribute__((aligned(8)));
+static size_t pool_allocator_used = 0;
+static pool_allocator_free_t * pool_allocator_free_lists[POOL_ALLOCATOR_CLASSES];
+static uint32_t pool_allocator_blocks[POOL_ALLOCATOR_CLASSES];
+static pool_allocator_tag_stats_t pool_allocator_stats[POOL_TAG_COUNT];
+static pool_allocator_tag_t pool_allocator_current_tag = POOL_TAG_OTHER;
+static const pool_allocator_tag_t pool_allocator_tag_ids[POOL_TAG_COUNT] = {
+	POOL_TAG_RMW, POOL_TAG_NODE, POOL_TAG_EXECUTOR, POOL_TAG_MESSAGES, POOL_TAG_OTHER
+};
+static const char * const pool_allocator_tag_names[POOL_TAG_COUNT] = {
+	"rmw", "node", "executor", "messages", "other"
+};
+
+static inline int pool_allocator_class_of(size_t size)
+{
+	// The header would wrap the block size around to a small class
+	if (size > SIZE_MAX - POOL_ALLOCATOR_HEADER) {
+		return -1;
+	}
+
+	size_t block = size + POOL_ALLOCATOR_HEADER;
+	if (block > ((size_t)1 << POOL_ALLOCATOR_MAX_SHIFT)) {
+		return -1;
+	}
+	if (block <= ((size_t)1 << POOL_ALLOCATOR_MIN_SHIFT)) {
+		return 0;
+	}
+
+	unsigned int shift = 32u - (unsigned int)__builtin_clz((uint32_t)(block - 1));
+	return (int)(shift - POOL_ALLOCATOR_MIN_SHIFT);
+}
+
+static inline pool_allocator_tag_t pool_allocator_tag_of(void * state)
+{
+	return (state != NULL) ? *(const pool_allocator_tag_t *)state : pool_allocator_current_tag;
+}
+
+static void * pool_allocator_allocate(size_t size, void * state)
+{
+	pool_allocator_tag_t tag = pool_allocator_tag_of(state);
+	int size_class = pool_allocator_class_of((size == 0) ? 1 : size);
+	uint8_t * block = NULL;
+
+	POOL_ALLOCATOR_LOCK();
+	if (size_class >= 0) {
+		size_t block_size = (size_t)1 << (size_class + POOL_ALLOCATOR_MIN_SHIFT);
+		if (pool_allocator_free_lists[size_class] != NULL) {
+			block = (uint8_t *)pool_allocator_free_lists[size_class];
+			pool_allocator_free_lists[size_class] = pool_allocator_free_lists[size_class]->next;
+		} else if (POOL_ALLOCATOR_ARENA_SIZE - pool_allocator_used >= block_size) {
+			block = &pool_allocator_arena[pool_allocator_used];
+			pool_allocator_used += block_size;
+			pool_allocator_blocks[size_class]++;
+		}
+	}
+
+	pool_allocator_tag_stats_t * stats = &pool_allocator_stats[tag];
+	if (block != NULL) {
+		pool_allocator_header_t * header = (pool_allocator_header_t *)block;
+		header->magic = POOL_ALLOCATOR_MAGIC;
+		header->size_class = (uint8_t)size_class;
+		header->tag = (uint8_t)tag;
+		header->size = (uint32_t)size;
+
+		stats->allocations++;
+		stats->bytes += (uint32_t)size;
+		if (stats->bytes > stats->peak_bytes) {
+			stats->peak_bytes = stats->bytes;
+		}
+	} else {
+		stats->failures++;
+	}
+	POOL_ALLOCATOR_UNLOCK();
+
+	if (block == NULL) {
+		POOL_ALLOCATOR_PRINTF("Pool allocator exhausted: %u bytes for %s\n",
+			(unsigned int)size, pool_allocator_tag_names[tag]);
+		return NULL;
+	}
+
+	return block + POOL_ALLOCATOR_HEADER;
+}
+
+// Header of a live block, or NULL when 'pointer' did not come from the arena.
+// Only valid under POOL_ALLOCATOR_LOCK(), since it reads the bump pointer.
+static inline pool_allocator_header_t * pool_allocator_header_of(void * pointer)
+{
+	uintptr_t address = (uintptr_t)pointer;
+	uintptr_t base = (uintptr_t)pool_allocator_arena;
+	if (address < base + POOL_ALLOCATOR_HEADER || address - base > pool_allocator_used) {
+		return NULL;
+	}
+
+	// Every block starts on a multiple of the smallest class
+	size_t offset = address - base - POOL_ALLOCATOR_HEADER;
+	if ((offset & (((size_t)1 << POOL_ALLOCATOR_MIN_SHIFT) - 1)) != 0) {
+		return NULL;
+	}
+
+	pool_allocator_header_t * header = (pool_allocator_header_t *)&pool_allocator_arena[offset];
+	if (header->magic != POOL_ALLOCATOR_MAGIC ||
+		header->size_class >= POOL_ALLOCATOR_CLASSES || header->tag >= POOL_TAG_COUNT ||
+		offset + ((size_t)1 << (header->size_class + POOL_ALLOCATOR_MIN_SHIFT)) > pool_allocator_used)
+	{
+		return NULL;
+	}
+	return header;
+}
+
+static void pool_allocator_deallocate(void * pointer, void * state)
+{
+	(void) state;
+	if (pointer == NULL) {
+		return;
+	}
+
+	POOL_ALLOCATOR_LOCK();
+	pool_allocator_header_t * header = pool_allocator_header_of(pointer);
+	if (header != NULL) {
+		pool_allocator_tag_stats_t * stats = &pool_allocator_stats[header->tag];
+		stats->frees++;
+		stats->bytes -= header->size;
+
+		int size_class = header->size_class;
+		header->magic = 0;
+		pool_allocator_free_t * node = (pool_allocator_free_t *)header;
+		node->next = pool_allocator_free_lists[size_class];
+		pool_allocator_free_lists[size_class] = node;
+	}
+	POOL_ALLOCATOR_UNLOCK();
+
+	if (header == NULL) {
+		POOL_ALLOCATOR_PRINTF("Pool allocator: invalid free of %p\n", pointer);
+	}
+}
+
+static void * pool_allocator_reallocate(void * pointer, size_t size, void * state)
+{
+	if (pointer == NULL) {
+		return pool_allocator_allocate(size, state);
+	}
+
+	POOL_ALLOCATOR_LOCK();
+	pool_allocator_header_t * header = pool_allocator_header_of(pointer);
+	if (header == NULL) {
+		POOL_ALLOCATOR_UNLOCK();
+		POOL_ALLOCATOR_PRINTF("Pool allocator: invalid reallocate of %p\n", pointer);
+		return NULL;
+	}
+
+	// Still fits in the same block: only the accounting changes
+	size_t old_size = header->size;
+	if (pool_allocator_class_of(size) == header->size_class) {
+		pool_allocator_tag_stats_t * stats = &pool_allocator_stats[header->tag];
+		stats->bytes = stats->bytes - header->size + (uint32_t)size;
+		if (stats->bytes > stats->peak_bytes) {
+			stats->peak_bytes = stats->bytes;
+		}
+		header->size = (uint32_t)size;
+		POOL_ALLOCATOR_UNLOCK();
+		return pointer;
+	}
+	POOL_ALLOCATOR_UNLOCK();
+
+	void * moved = pool_allocator_allocate(size, state);
+	if (moved == NULL) {
+		return NULL;
+	}
+	memcpy(moved, pointer, (old_size < size) ? old_size : size);
+	pool_allocator_deallocate(pointer, state);
+	return moved;
+}
+
+static void * pool_allocator_zero_allocate(size_t number_of_elements, size_t size_of_element, void * state)
+{
+	if (size_of_element != 0 && number_of_elements > SIZE_MAX / size_of_element) {
+		return NULL;
+	}
+
+	size_t size = number_of_elements * size_of_element;
+	void * pointer = pool_allocator_allocate(size, state);
+	if (pointer != NULL) {
+		memset(pointer, 0, size);
+	}
+	return pointer;
+}
+
+// Allocator that charges every allocation to 'tag'
+static inline rcutils_allocator_t pool_allocator_get(pool_allocator_tag_t tag)
+{
+	rcutils_allocator_t allocator = rcutils_get_zero_initialized_allocator();
+	allocator.allocate = pool_allocator_allocate;
+	allocator.deallocate = pool_allocator_deallocate;
+	allocator.reallocate = pool_allocator_reallocate;
+	allocator.zero_allocate = pool_allocator_zero_allocate;
+	allocator.state = (void *)&pool_allocator_tag_ids[tag];
+	return allocator;
+}
+
+// Tag charged by the default allocator from now on
+static inline void pool_allocator_set_tag(pool_allocator_tag_t tag)
+{
+	pool_allocator_current_tag = tag;
+}
+
+// Makes the pool the rcutils default allocator, to be called before rclc_support_init()
+static inline bool pool_allocator_install(void)
+{
+	rcutils_allocator_t allocator = pool_allocator_get(POOL_TAG_OTHER);
+	allocator.state = NULL;
+	return rcutils_set_default_allocator(&allocator);
+}
+
+static inline pool_allocator_tag_stats_t pool_allocator_get_stats(pool_allocator_tag_t tag)
+{
+	pool_allocator_tag_stats_t stats;
+	POOL_ALLOCATOR_LOCK();
+	stats = pool_allocator_stats[tag];
+	POOL_ALLOCATOR_UNLOCK();
+	return stats;
+}
+
+// Bytes of the arena handed out so far; the arena never shrinks, so this is also its high-water mark
+static inline size_t pool_allocator_arena_used(void)
+{
+	return pool_allocator_used;
+}
+
+static inline void pool_allocator_print_stats(void)
+{
+	POOL_ALLOCATOR_PRINTF("Pool allocator arena: %u of %u bytes used\n",
+		(unsigned int)pool_allocator_used, (unsigned int)POOL_ALLOCATOR_ARENA_SIZE);
+
+	for (int tag = 0; tag < POOL_TAG_COUNT; tag++) {
+		pool_allocator_tag_stats_t stats = pool_allocator_get_stats((pool_allocator_tag_t)tag);
+		POOL_ALLOCATOR_PRINTF("  %-8s %6u bytes (peak %6u) allocs %u frees %u failures %u\n",
+			pool_allocator_tag_names[tag], (unsigned int)stats.bytes, (unsigned int)stats.peak_bytes,
+			(unsigned int)stats.allocations, (unsigned int)stats.frees, (unsigned int)stats.failures);
+	}
+
+	for (int size_class = 0; size_class < POOL_ALLOCATOR_CLASSES; size_class++) {
+		if (pool_allocator_blocks[size_class] != 0) {
+			POOL_ALLOCATOR_PRINTF("  class %5u bytes: %u blocks\n",
+				1u << (size_class + POOL_ALLOCATOR_MIN_SHIFT), (unsigned int)pool_allocator_blocks[size_class]);
+		}
+	}
+}
+
+#endif /* POOL_ALLOCATOR_H_ */
@@ -0,0 +1,92 @@
+#ifndef SPSC_RING_H_
+#define SPSC_RING_H_
+
+// Lock-free single-producer/single-consumer ring of fixed-size elements.
+//
+// Exactly one task may push and exactly one task may pop. head is written
+// only by the producer and tail only by the consumer; an element is copied
+// in before head is published (release) and copied out before tail is
+// published, so the consumer never sees a half-written sample. When the
+// ring is full the new element is dropped and counted, the producer never
+// blocks or overwrites data the consumer may be reading.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+typedef struct spsc_ring_t {
+	uint8_t * storage;
+	size_t element_size;
+	uint32_t mask;
+	uint32_t head;
+	uint32_t tail;
+	// Producer side statistics
+	uint32_t pushed;
+	uint32_t dropped;
+	uint32_t high_water;
+} spsc_ring_t;
+
+// 'storage' holds 'capacity' elements of 'element_size' bytes, capacity must be a power of two
+static inline bool spsc_ring_init(spsc_ring_t * ring, void * storage, size_t element_size, uint32_t capacity)
+{
+	if (storage == NULL || element_size == 0 || capacity == 0 || (capacity & (capacity - 1)) != 0) {
+		return false;
+	}
+
+	ring->storage = (uint8_t *)storage;
+	ring->element_size = element_size;
+	ring->mask = capacity - 1;
+	ring->head = 0;
+	ring->tail = 0;
+	ring->pushed = 0;
+	ring->dropped = 0;
+	ring->high_water = 0;
+	return true;
+}
+
+// Elements waiting to be popped, exact on the consumer side
+static inline uint32_t spsc_ring_count(const spsc_ring_t * ring)
+{
+	uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+	uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+	return head - tail;
+}
+
+// Producer only; returns false and counts a drop if the ring is full
+static inline bool spsc_ring_push(spsc_ring_t * ring, const void * element)
+{
+	uint32_t head = ring->head;
+	uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+
+	if (head - tail > ring->mask) {
+		ring->dropped++;
+		return false;
+	}
+
+	memcpy(ring->storage + (size_t)(head & ring->mask) * ring->element_size, element, ring->element_size);
+	__atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+
+	ring->pushed++;
+	if (head + 1 - tail > ring->high_water) {
+		ring->high_water = head + 1 - tail;
+	}
+	return true;
+}
+
+// Consumer only; returns false if the ring is empty
+static inline bool spsc_ring_pop(spsc_ring_t * ring, void * element)
+{
+	uint32_t tail = ring->tail;
+	uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+
+	if (head == tail) {
+		return false;
+	}
+
+	memcpy(element, ring->storage + (size_t)(tail & ring->mask) * ring->element_size, ring->element_size);
+	__atomic_store_n(&ring->tail, tail + 1, __ATOMIC_RELEASE);
+	return true;
+}
+
+#endif /* SPSC_RING_H_ */
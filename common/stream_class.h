@@ -0,0 +1,85 @@
+#ifndef STREAM_CLASS_H_
+#define STREAM_CLASS_H_
+
+// Stream classes for publishers and subscriptions.
+//
+// A Micro XRCE-DDS session has one reliable and one best-effort output
+// stream, each with its own buffer. rmw_microxrcedds puts an entity on one
+// or the other by its reliability QoS, and a reliable publish waits until
+// the agent confirms the whole reliable stream. When bulk data and
+// commands share the reliable stream, a burst of data fills its history
+// and every command waits behind it.
+//
+// Each entity is created for a class instead of with an ad hoc QoS:
+//   STREAM_CLASS_CONTROL    commands, setpoints, acknowledgements: reliable,
+//                           keep last, on the reliable stream
+//   STREAM_CLASS_TELEMETRY  periodic samples where only the newest matters:
+//                           best effort, keep last 1, on the best-effort
+//                           stream, never waits for the agent
+// The reliable stream is then left to control traffic and entity creation.
+//
+// Its size is RMW_UXRCE_STREAM_HISTORY in the app's colcon meta. That value
+// counts MTU-sized slots and applies to the reliable input and output
+// streams alike. Each message that fits in one MTU takes one slot until the
+// peer confirms it. The client rmw ignores the QoS depth, so
+// STREAM_CLASS_CONTROL_DEPTH only reaches the agent's DDS entity and does not
+// reserve any slots. Size the history from the direction the control entities
+// use. Control publishers fill the output stream and control subscriptions
+// fill the input stream. Reserve one slot per message of a burst (more if a
+// message fragments, see xrce_fragments.h) and room for a second burst that
+// arrives before the first is confirmed. pub_sub_one receives its commands
+// through a control subscription, so 8 slots cover two bursts of
+// STREAM_CLASS_CONTROL_DEPTH Int32 samples on its input stream.
+// bench_stream_classes uses the same 8 for its Header round trip. The default
+// of 4 is enough for apps with telemetry only.
+
+#include <rcl/rcl.h>
+#include <rmw/qos_profiles.h>
+
+// Samples kept per control entity
+#ifndef STREAM_CLASS_CONTROL_DEPTH
+#define STREAM_CLASS_CONTROL_DEPTH 4
+#endif
+
+typedef enum stream_class_t {
+	STREAM_CLASS_CONTROL,
+	STREAM_CLASS_TELEMETRY,
+} stream_class_t;
+
+static inline rmw_qos_profile_t stream_class_qos(stream_class_t stream_class)
+{
+	rmw_qos_profile_t qos = rmw_qos_profile_default;
+
+	qos.history = RMW_QOS_POLICY_HISTORY_KEEP_LAST;
+	qos.durability = RMW_QOS_POLICY_DURABILITY_VOLATILE;
+	if (stream_class == STREAM_CLASS_TELEMETRY) {
+		qos.reliability = RMW_QOS_POLICY_RELIABILITY_BEST_EFFORT;
+		qos.depth = 1;
+	} else {
+		qos.reliability = RMW_QOS_POLICY_RELIABILITY_RELIABLE;
+		qos.depth = STREAM_CLASS_CONTROL_DEPTH;
+	}
+	return qos;
+}
+
+static inline rcl_ret_t stream_class_publisher_init(rcl_publisher_t * publisher, const rcl_node_t * node,
+	const rosidl_message_type_support_t * type_support, const char * topic_name, stream_class_t stream_class)
+{
+	rcl_publisher_options_t options = rcl_publisher_get_default_options();
+	options.qos = stream_class_qos(stream_class);
+
+	*publisher = rcl_get_zero_initialized_publisher();
+	return rcl_publisher_init(publisher, node, type_support, topic_name, &options);
+}
+
+static inline rcl_ret_t stream_class_subscription_init(rcl_subscription_t * subscription, const rcl_node_t * node,
+	const rosidl_message_type_support_t * type_support, const char * topic_name, stream_class_t stream_class)
+{
+	rcl_subscription_options_t options = rcl_subscription_get_default_options();
+	options.qos = stream_class_qos(stream_class);
+
+	*subscription = rcl_get_zero_initialized_subscription();
+	return rcl_subscription_init(subscription, node, type_support, topic_name, &options);
+}
+
+#endif /* STREAM_CLASS_H_ */
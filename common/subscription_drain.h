@@ -0,0 +1,87 @@
+#ifndef SUBSCRIPTION_DRAIN_H_
+#define SUBSCRIPTION_DRAIN_H_
+
+// Drain-all-available-samples subscription mode.
+//
+// With ON_NEW_DATA the rclc executor takes at most one sample per
+// subscription and spin, so a burst has to wait for later spins and is lost
+// once the rmw history is full. A drained subscription keeps calling
+// rcl_take() after the executor's own take, invoking the user callback once
+// per sample, until the subscription is empty or SUBSCRIPTION_DRAIN_BURST
+// samples have been handled in this spin.
+//
+// The executor hands callbacks only the message pointer, so entries are
+// looked up by the message buffer registered with subscription_drain_add().
+//
+// Draining only helps if the rmw can queue more than one sample, so apps
+// using it need RMW_UXRCE_MAX_HISTORY above 1 in their app-colcon.meta.
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <rcl/rcl.h>
+#include <rclc/executor.h>
+
+// Drained subscriptions per application
+#ifndef SUBSCRIPTION_DRAIN_MAX
+#define SUBSCRIPTION_DRAIN_MAX 4
+#endif
+
+// Samples handled per subscription and spin, bounds the time spent in one callback
+#ifndef SUBSCRIPTION_DRAIN_BURST
+#define SUBSCRIPTION_DRAIN_BURST 16
+#endif
+
+typedef struct subscription_drain_t {
+	rcl_subscription_t * subscription;
+	void * msg;
+	rclc_callback_t callback;
+} subscription_drain_t;
+
+static subscription_drain_t subscription_drain_table[SUBSCRIPTION_DRAIN_MAX];
+static size_t subscription_drain_count = 0;
+
+static void subscription_drain_dispatch(const void * msgin)
+{
+	subscription_drain_t * entry = NULL;
+	for (size_t i = 0; i < subscription_drain_count; i++) {
+		if (subscription_drain_table[i].msg == msgin) {
+			entry = &subscription_drain_table[i];
+			break;
+		}
+	}
+	if (entry == NULL) {
+		return;
+	}
+
+	// The executor already took the first sample into entry->msg
+	uint32_t burst = 0;
+	do {
+		entry->callback(entry->msg);
+		burst++;
+	} while (burst < SUBSCRIPTION_DRAIN_BURST &&
+		rcl_take(entry->subscription, entry->msg, NULL, NULL) == RCL_RET_OK);
+}
+
+// Drop-in replacement for rclc_executor_add_subscription(..., ON_NEW_DATA)
+static inline rcl_ret_t subscription_drain_add(rclc_executor_t * executor,
+	rcl_subscription_t * subscription, void * msg, rclc_callback_t callback)
+{
+	if (subscription_drain_count >= SUBSCRIPTION_DRAIN_MAX) {
+		return RCL_RET_ERROR;
+	}
+
+	subscription_drain_t * entry = &subscription_drain_table[subscription_drain_count];
+	entry->subscription = subscription;
+	entry->msg = msg;
+	entry->callback = callback;
+
+	rcl_ret_t rc = rclc_executor_add_subscription(executor, subscription, msg,
+		&subscription_drain_dispatch, ON_NEW_DATA);
+	if (rc == RCL_RET_OK) {
+		subscription_drain_count++;
+	}
+	return rc;
+}
+
+#endif /* SUBSCRIPTION_DRAIN_H_ */
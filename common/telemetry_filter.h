@@ -0,0 +1,118 @@
+#ifndef TELEMETRY_FILTER_H_
+#define TELEMETRY_FILTER_H_
+
+// Deadband and rate limiting stage for periodic telemetry.
+//
+// A sample is published when any field moved more than its deadband away
+// from the last *published* value, but never sooner than min_interval_ms
+// after the previous publication. If nothing moved, a heartbeat still goes
+// out every max_interval_ms so subscribers can tell a hovering vehicle from
+// a lost link. Comparing against the last published value (not the last
+// sampled one) keeps slow drifts from hiding below the deadband forever.
+//
+// Every suppressed sample is credited with the frame size the caller
+// passed, so bytes_saved shows what the filter keeps off the link.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifndef TELEMETRY_FILTER_MAX_FIELDS
+#define TELEMETRY_FILTER_MAX_FIELDS 9
+#endif
+
+typedef struct telemetry_filter_t {
+	size_t fields;
+	float deadband[TELEMETRY_FILTER_MAX_FIELDS];
+	float last[TELEMETRY_FILTER_MAX_FIELDS];
+	uint32_t min_interval_ms;
+	uint32_t max_interval_ms;
+	uint32_t last_publish_ms;
+	bool primed;
+	// Statistics
+	uint32_t offered;
+	uint32_t published;
+	uint32_t heartbeats;
+	uint32_t suppressed;
+	uint32_t rate_limited;
+	uint32_t bytes_sent;
+	uint32_t bytes_saved;
+} telemetry_filter_t;
+
+// 'deadband' holds one threshold per field, 0 publishes on any change
+static inline bool telemetry_filter_init(telemetry_filter_t * filter, size_t fields, const float * deadband,
+	uint32_t min_interval_ms, uint32_t max_interval_ms)
+{
+	if (fields == 0 || fields > TELEMETRY_FILTER_MAX_FIELDS || min_interval_ms > max_interval_ms) {
+		return false;
+	}
+
+	filter->fields = fields;
+	for (size_t i = 0; i < fields; i++) {
+		filter->deadband[i] = deadband[i];
+		filter->last[i] = 0.0f;
+	}
+	filter->min_interval_ms = min_interval_ms;
+	filter->max_interval_ms = max_interval_ms;
+	filter->last_publish_ms = 0;
+	filter->primed = false;
+
+	filter->offered = 0;
+	filter->published = 0;
+	filter->heartbeats = 0;
+	filter->suppressed = 0;
+	filter->rate_limited = 0;
+	filter->bytes_sent = 0;
+	filter->bytes_saved = 0;
+	return true;
+}
+
+// Returns true if 'values' should be published now; 'frame_bytes' is the size the sample would take on the link
+static inline bool telemetry_filter_check(telemetry_filter_t * filter, const float * values, uint32_t now_ms,
+	size_t frame_bytes)
+{
+	filter->offered++;
+
+	bool publish = !filter->primed;
+	if (!publish) {
+		uint32_t elapsed = now_ms - filter->last_publish_ms;
+
+		if (elapsed < filter->min_interval_ms) {
+			filter->rate_limited++;
+		} else if (elapsed >= filter->max_interval_ms) {
+			filter->heartbeats++;
+			publish = true;
+		} else {
+			for (size_t i = 0; i < filter->fields; i++) {
+				float delta = values[i] - filter->last[i];
+				if (delta > filter->deadband[i] || -delta > filter->deadband[i]) {
+					publish = true;
+					break;
+				}
+			}
+		}
+	}
+
+	if (!publish) {
+		filter->suppressed++;
+		filter->bytes_saved += (uint32_t)frame_bytes;
+		return false;
+	}
+
+	for (size_t i = 0; i < filter->fields; i++) {
+		filter->last[i] = values[i];
+	}
+	filter->last_publish_ms = now_ms;
+	filter->primed = true;
+	filter->published++;
+	filter->bytes_sent += (uint32_t)frame_bytes;
+	return true;
+}
+
+// Makes the next sample go out regardless of deadband and interval, e.g. after a reconnection
+static inline void telemetry_filter_reset(telemetry_filter_t * filter)
+{
+	filter->primed = false;
+}
+
+#endif /* TELEMETRY_FILTER_H_ */
@@ -0,0 +1,154 @@
+#ifndef TELEMETRY_QUANT_H_
+#define TELEMETRY_QUANT_H_
+
+// Quantized fixed-point telemetry frame.
+//
+// Opt-in compact alternative to crazyflie_telemetry.h. Every value is
+// scaled to an int16, centidegrees for the attitude and millimetres for
+// the position by default, and the frame travels as a std_msgs/
+// Int16MultiArray:
+//   data[0..1]  sample time in ms, low and high 16 bits
+//   data[2..3]  frame sequence number, low and high 16 bits
+//   data[4..6]  pitch, roll, yaw   * TELEMETRY_QUANT_ATTITUDE_SCALE
+//   data[7..9]  x, y, z            * TELEMETRY_QUANT_POSITION_SCALE
+//   data[10..11] temperature, humidity * TELEMETRY_QUANT_WEATHER_SCALE (optional)
+// That is 32 CDR bytes for a pose against 52 for the float frame with its
+// sequence number. The sequence number lets the receiver count lost frames
+// on best-effort streams, and telemetry_decoder passes it on. The
+// default scales cover +-327 degrees and +-32 m; values outside the int16
+// range saturate and are counted. Encoder and decoder must be built with
+// the same scales.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include <std_msgs/msg/int16_multi_array.h>
+
+#define TELEMETRY_QUANT_TOPIC "/drone/telemetry_q"
+
+#ifndef TELEMETRY_QUANT_ATTITUDE_SCALE
+#define TELEMETRY_QUANT_ATTITUDE_SCALE 100.0f
+#endif
+
+#ifndef TELEMETRY_QUANT_POSITION_SCALE
+#define TELEMETRY_QUANT_POSITION_SCALE 1000.0f
+#endif
+
+#ifndef TELEMETRY_QUANT_WEATHER_SCALE
+#define TELEMETRY_QUANT_WEATHER_SCALE 100.0f
+#endif
+
+#define TELEMETRY_QUANT_TIME 0
+#define TELEMETRY_QUANT_SEQ 2
+#define TELEMETRY_QUANT_POSE 4
+#define TELEMETRY_QUANT_WEATHER 10
+#define TELEMETRY_QUANT_MAX_FIELDS 12
+
+typedef struct telemetry_quant_t {
+	std_msgs__msg__Int16MultiArray msg;
+	int16_t data[TELEMETRY_QUANT_MAX_FIELDS];
+	uint32_t saturated;
+} telemetry_quant_t;
+
+static inline int16_t telemetry_quant_scale(float value, float scale, uint32_t * saturated)
+{
+	float scaled = value * scale;
+
+	// Also catches NaN, which fails both comparisons below
+	if (!(scaled < 32767.0f)) {
+		if (saturated != NULL) {
+			(*saturated)++;
+		}
+		return (scaled != scaled) ? 0 : 32767;
+	}
+	if (scaled < -32768.0f) {
+		if (saturated != NULL) {
+			(*saturated)++;
+		}
+		return -32768;
+	}
+	return (int16_t)(scaled >= 0.0f ? scaled + 0.5f : scaled - 0.5f);
+}
+
+static inline void telemetry_quant_init(telemetry_quant_t * frame)
+{
+	for (int i = 0; i < TELEMETRY_QUANT_MAX_FIELDS; i++) {
+		frame->data[i] = 0;
+	}
+	frame->saturated = 0;
+
+	frame->msg.layout.dim.data = NULL;
+	frame->msg.layout.dim.size = 0;
+	frame->msg.layout.dim.capacity = 0;
+	frame->msg.layout.data_offset = 0;
+	frame->msg.data.data = frame->data;
+	frame->msg.data.size = TELEMETRY_QUANT_WEATHER;
+	frame->msg.data.capacity = TELEMETRY_QUANT_MAX_FIELDS;
+}
+
+// 'pose' is pitch, roll, yaw, x, y, z as produced by crazyflie_telemetry_pose_values()
+static inline void telemetry_quant_encode(telemetry_quant_t * frame, uint32_t time_ms, uint32_t seq, const float pose[6])
+{
+	frame->data[TELEMETRY_QUANT_TIME] = (int16_t)(uint16_t)(time_ms & 0xFFFF);
+	frame->data[TELEMETRY_QUANT_TIME + 1] = (int16_t)(uint16_t)(time_ms >> 16);
+	frame->data[TELEMETRY_QUANT_SEQ] = (int16_t)(uint16_t)(seq & 0xFFFF);
+	frame->data[TELEMETRY_QUANT_SEQ + 1] = (int16_t)(uint16_t)(seq >> 16);
+
+	for (int i = 0; i < 3; i++) {
+		frame->data[TELEMETRY_QUANT_POSE + i] =
+			telemetry_quant_scale(pose[i], TELEMETRY_QUANT_ATTITUDE_SCALE, &frame->saturated);
+		frame->data[TELEMETRY_QUANT_POSE + 3 + i] =
+			telemetry_quant_scale(pose[3 + i], TELEMETRY_QUANT_POSITION_SCALE, &frame->saturated);
+	}
+}
+
+// Attaches a weather sample to the next published frame
+static inline void telemetry_quant_set_weather(telemetry_quant_t * frame, float temperature, float humidity)
+{
+	frame->data[TELEMETRY_QUANT_WEATHER] =
+		telemetry_quant_scale(temperature, TELEMETRY_QUANT_WEATHER_SCALE, &frame->saturated);
+	frame->data[TELEMETRY_QUANT_WEATHER + 1] =
+		telemetry_quant_scale(humidity, TELEMETRY_QUANT_WEATHER_SCALE, &frame->saturated);
+	frame->msg.data.size = TELEMETRY_QUANT_MAX_FIELDS;
+}
+
+static inline void telemetry_quant_clear_weather(telemetry_quant_t * frame)
+{
+	frame->msg.data.size = TELEMETRY_QUANT_WEATHER;
+}
+
+// CDR payload size: empty layout.dim (4), data_offset (4), element count (4), 2 bytes per element
+static inline size_t telemetry_quant_serialized_size(const telemetry_quant_t * frame)
+{
+	return 12 + 2 * frame->msg.data.size;
+}
+
+// Decodes a received frame; returns false if it is too short. 'weather' may be NULL,
+// *has_weather tells whether the frame carried a sample.
+static inline bool telemetry_quant_decode(const int16_t * data, size_t size, uint32_t * time_ms,
+	uint32_t * seq, float pose[6], float weather[2], bool * has_weather)
+{
+	if (size < TELEMETRY_QUANT_WEATHER) {
+		return false;
+	}
+
+	*time_ms = (uint32_t)(uint16_t)data[TELEMETRY_QUANT_TIME] |
+		((uint32_t)(uint16_t)data[TELEMETRY_QUANT_TIME + 1] << 16);
+	*seq = (uint32_t)(uint16_t)data[TELEMETRY_QUANT_SEQ] |
+		((uint32_t)(uint16_t)data[TELEMETRY_QUANT_SEQ + 1] << 16);
+
+	for (int i = 0; i < 3; i++) {
+		pose[i] = data[TELEMETRY_QUANT_POSE + i] / TELEMETRY_QUANT_ATTITUDE_SCALE;
+		pose[3 + i] = data[TELEMETRY_QUANT_POSE + 3 + i] / TELEMETRY_QUANT_POSITION_SCALE;
+	}
+
+	*has_weather = size >= TELEMETRY_QUANT_MAX_FIELDS;
+	if (*has_weather && weather != NULL) {
+		weather[0] = data[TELEMETRY_QUANT_WEATHER] / TELEMETRY_QUANT_WEATHER_SCALE;
+		weather[1] = data[TELEMETRY_QUANT_WEATHER + 1] / TELEMETRY_QUANT_WEATHER_SCALE;
+	}
+	return true;
+}
+
+#endif /* TELEMETRY_QUANT_H_ */
@@ -0,0 +1,68 @@
+#ifndef XRCE_FRAGMENTS_H_
+#define XRCE_FRAGMENTS_H_
+
+// Fragment arithmetic of Micro XRCE-DDS reliable streams.
+//
+// A message that does not fit into one transport MTU is sent as FRAGMENT
+// submessages over a reliable stream and reassembled on the other side in
+// the stream's input buffer, RMW_UXRCE_STREAM_HISTORY slots of one MTU each.
+// A message needing more fragments than there are slots can never be
+// reassembled and is dropped without any error on the receiving side.
+// Best-effort streams do not fragment at all: anything over one MTU is
+// dropped.
+//
+// The helpers work on the serialized (CDR) size of a message, e.g.
+// message_memory_serialized_size(), so an app can check at startup that its
+// largest message fits the stream it is received on:
+//   if (!xrce_fragments_fit(serialized, MY_TRANSPORT_MTU, MY_STREAM_HISTORY)) ...
+// MTU and history are the values the micro-ROS client was built with and
+// have to be kept in line with the app's colcon meta by hand.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Message header: session id, stream id, sequence number (no client key)
+#define XRCE_FRAGMENTS_MESSAGE_HEADER 4
+// Submessage header, of the WRITE_DATA and of every FRAGMENT
+#define XRCE_FRAGMENTS_SUBMESSAGE_HEADER 4
+// Request and object id of WRITE_DATA
+#define XRCE_FRAGMENTS_WRITE_DATA_HEADER 4
+
+// Payload bytes a single message carries unfragmented
+static inline size_t xrce_fragments_single_capacity(size_t mtu)
+{
+	size_t overhead = XRCE_FRAGMENTS_MESSAGE_HEADER + XRCE_FRAGMENTS_SUBMESSAGE_HEADER + XRCE_FRAGMENTS_WRITE_DATA_HEADER;
+	return (mtu > overhead) ? mtu - overhead : 0;
+}
+
+// Number of transport messages 'serialized' payload bytes are sent in, 1 if unfragmented
+static inline size_t xrce_fragments_count(size_t serialized, size_t mtu)
+{
+	size_t per_fragment = mtu - XRCE_FRAGMENTS_MESSAGE_HEADER - XRCE_FRAGMENTS_SUBMESSAGE_HEADER;
+
+	if (serialized <= xrce_fragments_single_capacity(mtu)) {
+		return 1;
+	}
+	// The fragments carry the whole WRITE_DATA submessage, headers included
+	size_t submessage = XRCE_FRAGMENTS_SUBMESSAGE_HEADER + XRCE_FRAGMENTS_WRITE_DATA_HEADER + serialized;
+	return (submessage + per_fragment - 1) / per_fragment;
+}
+
+// Whether a reliable stream of 'history' slots can receive the message
+static inline bool xrce_fragments_fit(size_t serialized, size_t mtu, size_t history)
+{
+	return xrce_fragments_count(serialized, mtu) <= history;
+}
+
+// Largest payload a reliable stream of 'history' slots can receive
+static inline size_t xrce_fragments_max_payload(size_t mtu, size_t history)
+{
+	size_t per_fragment = mtu - XRCE_FRAGMENTS_MESSAGE_HEADER - XRCE_FRAGMENTS_SUBMESSAGE_HEADER;
+	size_t single = xrce_fragments_single_capacity(mtu);
+	size_t fragmented = per_fragment * history - XRCE_FRAGMENTS_SUBMESSAGE_HEADER - XRCE_FRAGMENTS_WRITE_DATA_HEADER;
+
+	return (history > 1 && fragmented > single) ? fragmented : single;
+}
+
+#endif /* XRCE_FRAGMENTS_H_ */
@@ -7,6 +7,7 @@
 #include <sensor_msgs/msg/laser_echo.h>
 #include <std_msgs/msg/float32.h>
 #include <geometry_msgs/msg/point32.h>
+#include <std_msgs/msg/u_int32_multi_array.h>
 
 #include <rcutils/allocator.h>
 #include <rmw_microros/rmw_microros.h>
@@ -25,28 +26,207 @@
 #include "crtp.h"
 #include "configblock.h"
 
+#include "../common/spsc_ring.h"
+#include "../common/stream_class.h"
+#include "../common/crazyflie_telemetry.h"
+#include "../common/crazyflie_log_snapshot.h"
+#include "../common/telemetry_filter.h"
+
+#define MEMORY_MONITOR_ALLOCATOR_USED() usedMemory
+#define MEMORY_MONITOR_ALLOCATOR_PEAK() absoluteUsedMemory
+#include "../common/memory_monitor.h"
+
 #define RCCHECK(clean) if((rc != RCL_RET_OK)){DEBUG_PRINT("Failed status on line %d: %d. Aborting.\n",__LINE__,(int)rc); goto clean;}
 #define RCSOFTCHECK() if((rc != RCL_RET_OK)){DEBUG_PRINT("Failed status on line %d: %d. Continuing.\n",__LINE__,(int)rc);}
 
 void microros_primary(void * params);
 void microros_secondary(void * params);
 
-float sensor_data[2];
-sensor_msgs__msg__LaserEcho sensor_topic;
-static bool sensor_data_ready;
+// 1: one session and one node publish and subscribe from the primary task.
+// 0: the secondary task runs its own session on radio channel 30 and hands
+//    samples over; needs RMW_UXRCE_MAX_NODES=2 and RMW_UXRCE_MAX_SESSIONS=2.
+#ifndef CRAZYFLIE_SINGLE_SESSION
+#define CRAZYFLIE_SINGLE_SESSION 1
+#endif
+
+// 1: attitude, position and weather samples share one telemetry frame
+// 0: one message per value on the original four topics
+#ifndef CRAZYFLIE_TELEMETRY_FRAME
+#define CRAZYFLIE_TELEMETRY_FRAME 1
+#endif
+
+#define POSE_PERIOD_MS 100
+
+#if CRAZYFLIE_TELEMETRY_FRAME
+// Pose-only frames are skipped while the pose stays inside the deadband
+// (degrees, meters), but one goes out at least every TELEMETRY_MAX_INTERVAL_MS
+#define TELEMETRY_DEADBAND_ATTITUDE 0.5f
+#define TELEMETRY_DEADBAND_POSITION 0.005f
+#define TELEMETRY_MAX_INTERVAL_MS 1000
+
+static telemetry_filter_t telemetry_filter;
+#endif
+
+typedef struct sensor_sample_t {
+    float temperature;
+    float humidity;
+} sensor_sample_t;
+
+#if !CRAZYFLIE_SINGLE_SESSION
+// Samples handed from the secondary (subscriber) to the primary (publisher) task
+#define SENSOR_RING_SIZE 8
+
+static sensor_sample_t sensor_ring_storage[SENSOR_RING_SIZE];
+static spsc_ring_t sensor_ring;
+static uint32_t sensor_overruns;
+static TaskHandle_t primary_task;
+#endif
+
+static log_snapshot_t pose_snapshot;
+
+// Heap, allocator and task stack figures, published every MEMORY_PERIOD_MS
+#define MEMORY_PERIOD_MS 1000
+
+static memory_monitor_t memory_monitor;
+
+// After a radio drop the session is resumed with the existing entities if
+// the agent still holds it; otherwise everything is rebuilt. A ping only
+// shows the agent is reachable: one restarted during the outage answers it
+// too, without the session and its entities, and best-effort publishes
+// never report that. So the session itself is checked with a time sync
+// round trip, which the agent only answers on a session it knows. An agent
+// restart drops every session, so the check holds for the secondary one
+// too. Outages longer than RESUME_MAX_OUTAGE_MS, kept below the agent's
+// client timeout, always rebuild.
+#define RESUME_PING_TIMEOUT_MS 100
+#define RESUME_PING_ATTEMPTS 5
+#define RESUME_SYNC_TIMEOUT_MS 200
+#define RESUME_MAX_OUTAGE_MS 10000
+
+typedef struct reconnect_stats_t {
+    uint32_t link_losses;
+    uint32_t resumes;
+    uint32_t rebuilds;
+    uint32_t last_ms;   // link restored to first published sample
+    uint32_t max_ms;
+} reconnect_stats_t;
+
+static reconnect_stats_t reconnect_stats;
+static TickType_t link_restored;
+static bool awaiting_first_sample = false;
+
+static void reconnect_sample_sent(void){
+    if (!awaiting_first_sample) {
+        return;
+    }
+    awaiting_first_sample = false;
 
-static int pitchid, rollid, yawid;
-static int Xid, Yid, Zid;
+    reconnect_stats.last_ms = (xTaskGetTickCount() - link_restored) * portTICK_RATE_MS;
+    if (reconnect_stats.last_ms > reconnect_stats.max_ms) {
+        reconnect_stats.max_ms = reconnect_stats.last_ms;
+    }
+    DEBUG_PRINT("Link restored to first sample: %u ms (%u resumes, %u rebuilds, worst %u ms)\n",
+        (unsigned int)reconnect_stats.last_ms, (unsigned int)reconnect_stats.resumes,
+        (unsigned int)reconnect_stats.rebuilds, (unsigned int)reconnect_stats.max_ms);
+}
 
 // Note: please set APP_STACKSIZE = 100 and CFLAGS += -DFREERTOS_HEAP_SIZE=12100 in Makefile before build
 
 STATIC_MEM_TASK_ALLOC(microros_primary, 1000);
+#if !CRAZYFLIE_SINGLE_SESSION
 STATIC_MEM_TASK_ALLOC(microros_secondary, 1000);
 static bool created_primary = false;
+#endif
+
+static rcl_ret_t sensor_subscription_init(rcl_subscription_t * sub_sensors, rcl_node_t * node){
+    const char * echo_topic_name = "Float__Sequence";
+
+    *sub_sensors = rcl_get_zero_initialized_subscription();
+    const rosidl_message_type_support_t * sub_type_support = ROSIDL_GET_MSG_TYPE_SUPPORT(sensor_msgs, msg, LaserEcho);
+    rcl_subscription_options_t subscription_ops = rcl_subscription_get_default_options();
+    subscription_ops.qos = stream_class_qos(STREAM_CLASS_TELEMETRY);
+
+    return rcl_subscription_init(
+        sub_sensors,
+        node,
+        sub_type_support,
+        echo_topic_name,
+        &subscription_ops);
+}
+
+static bool sensor_take(rcl_subscription_t * sub_sensors, sensor_sample_t * sample){
+    sensor_msgs__msg__LaserEcho rcv;
+    float rcv_data[2];
+
+    rcv.echoes.capacity = 2;
+    rcv.echoes.size = 2;
+    rcv.echoes.data = rcv_data;
+
+    if (rcl_take(sub_sensors, &rcv, NULL, NULL) != RCL_RET_OK || rcv.echoes.size < 2) {
+        return false;
+    }
+
+    sample->temperature = rcv.echoes.data[0];
+    sample->humidity = rcv.echoes.data[1];
+    return true;
+}
+
+// Where the primary task gets its weather samples from: its own
+// subscription in single-session mode, the secondary task's ring otherwise
+typedef struct sensor_source_t {
+#if CRAZYFLIE_SINGLE_SESSION
+    rcl_subscription_t * subscription;
+    rcl_wait_set_t * wait_set;
+    bool ready;
+#else
+    spsc_ring_t * ring;
+#endif
+} sensor_source_t;
+
+// Blocks until a sample may be available or 'timeout' ticks have passed
+static void sensor_source_wait(sensor_source_t * source, TickType_t timeout){
+#if CRAZYFLIE_SINGLE_SESSION
+    rcl_ret_t rc;
+
+    // Service the subscription until the next pose is due
+    rc = rcl_wait_set_clear(source->wait_set);
+    RCSOFTCHECK()
+
+    rc = rcl_wait_set_add_subscription(source->wait_set, source->subscription, NULL);
+    RCSOFTCHECK()
+
+    rc = rcl_wait(source->wait_set, RCL_MS_TO_NS(timeout * portTICK_RATE_MS));
+    source->ready = (rc == RCL_RET_OK) && source->wait_set->subscriptions[0];
+#else
+    // Sleep until the secondary hands over a sample or the next pose is due
+    if (timeout > 0) {
+        ulTaskNotifyTake(pdTRUE, timeout);
+    }
+
+    // More than one queued sample means the publisher fell behind
+    if (spsc_ring_count(source->ring) > 1) {
+        sensor_overruns++;
+    }
+#endif
+}
+
+// Returns the samples made available by the last sensor_source_wait(), one per call
+static bool next_sensor_sample(sensor_source_t * source, sensor_sample_t * sample){
+#if CRAZYFLIE_SINGLE_SESSION
+    // One take per wait
+    if (!source->ready) {
+        return false;
+    }
+    source->ready = false;
+    return sensor_take(source->subscription, sample);
+#else
+    return spsc_ring_pop(source->ring, sample);
+#endif
+}
 
 void appMain(){ 
     BaseType_t rc __attribute__((unused));
-    // TaskHandle_t task_primary, task_secondary;
+    TaskHandle_t task_primary;
 
     absoluteUsedMemory = 0;
     usedMemory = 0;
@@ -63,15 +243,33 @@ void appMain(){
     }
 
 
-    sensor_topic.echoes.capacity = 2;
-    sensor_topic.echoes.size = 2;
-    sensor_topic.echoes.data = sensor_data;
-
-    STATIC_MEM_TASK_CREATE(microros_primary, microros_primary, "microROSprimary", NULL, 3);
-    STATIC_MEM_TASK_CREATE(microros_secondary, microros_secondary, "microROSsecondary", NULL, 3);
+#if CRAZYFLIE_TELEMETRY_FRAME
+    const float deadband[6] = {
+        TELEMETRY_DEADBAND_ATTITUDE, TELEMETRY_DEADBAND_ATTITUDE, TELEMETRY_DEADBAND_ATTITUDE,
+        TELEMETRY_DEADBAND_POSITION, TELEMETRY_DEADBAND_POSITION, TELEMETRY_DEADBAND_POSITION
+    };
+    telemetry_filter_init(&telemetry_filter, 6, deadband, 0, TELEMETRY_MAX_INTERVAL_MS);
+#endif
+
+    memory_monitor_init(&memory_monitor);
+
+    // Both tasks are registered here, before either runs, so the monitor is
+    // never written from two tasks
+    task_primary = STATIC_MEM_TASK_CREATE(microros_primary, microros_primary, "microROSprimary", NULL, 3);
+    memory_monitor_add_task(&memory_monitor, task_primary);
+#if !CRAZYFLIE_SINGLE_SESSION
+    TaskHandle_t task_secondary;
+    spsc_ring_init(&sensor_ring, sensor_ring_storage, sizeof(sensor_sample_t), SENSOR_RING_SIZE);
+    task_secondary = STATIC_MEM_TASK_CREATE(microros_secondary, microros_secondary, "microROSsecondary", NULL, 3);
+    memory_monitor_add_task(&memory_monitor, task_secondary);
+#endif
 }
 
 void microros_primary(void * params){
+#if !CRAZYFLIE_SINGLE_SESSION
+    primary_task = xTaskGetCurrentTaskHandle();
+#endif
+
     while(1){
 
         // ####################### RADIO INIT #######################
@@ -85,11 +283,28 @@ void microros_primary(void * params){
         DEBUG_PRINT("Free heap pre uROS: %d bytes\n", xPortGetFreeHeapSize());
         vTaskDelay(50);
 
-        rcl_context_t      context;
+        rcl_context_t      context = rcl_get_zero_initialized_context();
         rcl_init_options_t init_options;
         rcl_ret_t          rc;
         rcl_ret_t          rc_aux __attribute__((unused));
 
+        // Every entity starts zero initialized, so clean1 can finalize all of
+        // them whatever step failed; fini of a zero entity is a no-op
+        rcl_node_t node = rcl_get_zero_initialized_node();
+#if CRAZYFLIE_TELEMETRY_FRAME
+        rcl_publisher_t pub_telemetry = rcl_get_zero_initialized_publisher();
+#else
+        rcl_publisher_t pub_sensors_temp = rcl_get_zero_initialized_publisher();
+        rcl_publisher_t pub_sensors_hum = rcl_get_zero_initialized_publisher();
+        rcl_publisher_t pub_odom = rcl_get_zero_initialized_publisher();
+        rcl_publisher_t pub_attitude = rcl_get_zero_initialized_publisher();
+#endif
+        rcl_publisher_t pub_memory = rcl_get_zero_initialized_publisher();
+#if CRAZYFLIE_SINGLE_SESSION
+        rcl_subscription_t sub_sensors = rcl_get_zero_initialized_subscription();
+        rcl_wait_set_t wait_set = rcl_get_zero_initialized_wait_set();
+#endif
+
         init_options = rcl_get_zero_initialized_init_options();                          
         rc = rcl_init_options_init(&init_options, rcutils_get_default_allocator());      
         RCCHECK(clean1)
@@ -104,22 +319,32 @@ void microros_primary(void * params){
             crazyflie_serial_read
         ); 
 
-        context = rcl_get_zero_initialized_context();                                    
-
         rc = rcl_init(0, NULL, &init_options, &context);
         rc_aux = rcl_init_options_fini(&init_options);
         RCCHECK(clean1)
 
-        rcl_node_t node = rcl_get_zero_initialized_node();
         rcl_node_options_t node_ops = rcl_node_get_default_options();
 
         rc = rcl_node_init(&node, "crazyflie_node_1", "", &context, &node_ops);
         RCCHECK(clean1)
 
+#if CRAZYFLIE_TELEMETRY_FRAME
+        // Create telemetry publisher
+        rcl_publisher_options_t pub_opt_telemetry = rcl_publisher_get_default_options();
+        pub_opt_telemetry.qos = stream_class_qos(STREAM_CLASS_TELEMETRY);
+
+        rc = rcl_publisher_init(
+            &pub_telemetry,
+            &node,
+            ROSIDL_GET_MSG_TYPE_SUPPORT(geometry_msgs, msg, PolygonStamped),
+            CRAZYFLIE_TELEMETRY_TOPIC,
+            &pub_opt_telemetry);
+
+        RCCHECK(clean1)
+#else
         // Create publisher 1
-        rcl_publisher_t pub_sensors_temp        = rcl_get_zero_initialized_publisher();
         rcl_publisher_options_t pub_opt_sensors_temp = rcl_publisher_get_default_options();
-        pub_opt_sensors_temp.qos.reliability = RMW_QOS_POLICY_RELIABILITY_BEST_EFFORT;
+        pub_opt_sensors_temp.qos = stream_class_qos(STREAM_CLASS_TELEMETRY);
 
         rc = rcl_publisher_init(
             &pub_sensors_temp,
@@ -128,15 +353,11 @@ void microros_primary(void * params){
             "/weather_station/temperature",
             &pub_opt_sensors_temp);
 
-        if(rc != RCL_RET_OK){
-            rc_aux = rcl_node_fini(&node);
-        }
         RCCHECK(clean1)
 
         // Create publisher 2
-        rcl_publisher_t pub_sensors_hum        = rcl_get_zero_initialized_publisher();
         rcl_publisher_options_t pub_opt_sensors_hum = rcl_publisher_get_default_options();
-        pub_opt_sensors_hum.qos.reliability = RMW_QOS_POLICY_RELIABILITY_BEST_EFFORT;
+        pub_opt_sensors_hum.qos = stream_class_qos(STREAM_CLASS_TELEMETRY);
 
         rc = rcl_publisher_init(
             &pub_sensors_hum,
@@ -145,15 +366,11 @@ void microros_primary(void * params){
             "/weather_station/humidity",
             &pub_opt_sensors_hum);
 
-        if(rc != RCL_RET_OK){
-            rc_aux = rcl_node_fini(&node);
-        }
         RCCHECK(clean1)
 
         // Create publisher 3
-        rcl_publisher_t pub_odom        = rcl_get_zero_initialized_publisher();
         rcl_publisher_options_t pub_opt_odom = rcl_publisher_get_default_options();
-        pub_opt_odom.qos.reliability = RMW_QOS_POLICY_RELIABILITY_BEST_EFFORT;
+        pub_opt_odom.qos = stream_class_qos(STREAM_CLASS_TELEMETRY);
 
         rc = rcl_publisher_init(
             &pub_odom,
@@ -164,9 +381,8 @@ void microros_primary(void * params){
         RCCHECK(clean1)
 
         // Create publisher 4
-        rcl_publisher_t pub_attitude        = rcl_get_zero_initialized_publisher();
         rcl_publisher_options_t pub_opt_att = rcl_publisher_get_default_options();
-        pub_opt_att.qos.reliability = RMW_QOS_POLICY_RELIABILITY_BEST_EFFORT;
+        pub_opt_att.qos = stream_class_qos(STREAM_CLASS_TELEMETRY);
 
         rc = rcl_publisher_init(
             &pub_attitude,
@@ -175,69 +391,235 @@ void microros_primary(void * params){
             "/drone/attitude",
             &pub_opt_att);
         RCCHECK(clean1)
+#endif
+
+        // Create memory diagnostics publisher
+        rcl_publisher_options_t pub_opt_memory = rcl_publisher_get_default_options();
+        pub_opt_memory.qos = stream_class_qos(STREAM_CLASS_TELEMETRY);
+
+        rc = rcl_publisher_init(
+            &pub_memory,
+            &node,
+            ROSIDL_GET_MSG_TYPE_SUPPORT(std_msgs, msg, UInt32MultiArray),
+            "/drone/memory",
+            &pub_opt_memory);
+        RCCHECK(clean1)
+
+        std_msgs__msg__UInt32MultiArray memory_stats;
+        memory_stats.layout.dim.data = NULL;
+        memory_stats.layout.dim.size = 0;
+        memory_stats.layout.dim.capacity = 0;
+        memory_stats.layout.data_offset = 0;
+        memory_stats.data.data = memory_monitor.fields;
+        memory_stats.data.size = 0;
+        memory_stats.data.capacity = MEMORY_MONITOR_MAX_FIELDS;
+
+#if CRAZYFLIE_SINGLE_SESSION
+        // Create subscription on the same node and session
+        rc = sensor_subscription_init(&sub_sensors, &node);
+        RCCHECK(clean1)
+
+        rc = rcl_wait_set_init(&wait_set, 1, 0, 0, 0, 0, 0, &context, rcl_get_default_allocator());
+        RCCHECK(clean1)
+
+        sensor_source_t sensor_source = { &sub_sensors, &wait_set, false };
+#else
+        sensor_source_t sensor_source = { &sensor_ring };
+#endif
 
         DEBUG_PRINT("Free heap post uROS configuration: %d bytes\n", xPortGetFreeHeapSize());
         DEBUG_PRINT("uROS Used Memory %d bytes\n", usedMemory);
         DEBUG_PRINT("uROS Absolute Used Memory %d bytes\n", absoluteUsedMemory);
 
+#if !CRAZYFLIE_SINGLE_SESSION
         created_primary = true;
+#endif
         // ####################### MAIN LOOP #######################
 
         // Init messages 
+#if CRAZYFLIE_TELEMETRY_FRAME
+        crazyflie_telemetry_t telemetry;
+        crazyflie_telemetry_init(&telemetry);
+        telemetry_filter_reset(&telemetry_filter);
+#else
         geometry_msgs__msg__Point32 pose;
         geometry_msgs__msg__Point32__init(&pose);
         geometry_msgs__msg__Point32 odom;
         geometry_msgs__msg__Point32__init(&odom);
+#endif
 
-        //Get pitch, roll and yaw value
-        pitchid = logGetVarId("stateEstimate", "pitch");
-        rollid = logGetVarId("stateEstimate", "roll");
-        yawid = logGetVarId("stateEstimate", "yaw");
+        //Get pitch, roll, yaw and X, Y, Z values as one snapshot group
+        log_snapshot_init(&pose_snapshot);
+        if (!log_snapshot_add_pose(&pose_snapshot)) {
+            DEBUG_PRINT("Missing stateEstimate log variables (line %d)\n",__LINE__);
+        }
+        crazyflie_pose_t state;
 
-        //Get X,Y and Z value
-        Xid = logGetVarId("stateEstimate", "x");
-        Yid = logGetVarId("stateEstimate", "y");
-        Zid = logGetVarId("stateEstimate", "z");
+        TickType_t next_pose = xTaskGetTickCount();
+        TickType_t next_memory = next_pose;
 
         while(1){
 
-            if(sensor_data_ready){
+            if (!logGetUint(radio_connected)) {
+                // Keep every entity if the agent still holds the session:
+                // with refs creation mode the entities live on with it
+                TickType_t link_lost = xTaskGetTickCount();
+                reconnect_stats.link_losses++;
+                while(!logGetUint(radio_connected)) vTaskDelay(10);
+                link_restored = xTaskGetTickCount();
+                awaiting_first_sample = true;
+
+                if ((link_restored - link_lost) * portTICK_RATE_MS > RESUME_MAX_OUTAGE_MS) {
+                    DEBUG_PRINT("Radio lost for %u ms, rebuilding session\n",
+                        (unsigned int)((link_restored - link_lost) * portTICK_RATE_MS));
+                    reconnect_stats.rebuilds++;
+                    break;
+                }
+                if (rmw_uros_ping_agent(RESUME_PING_TIMEOUT_MS, RESUME_PING_ATTEMPTS) != RMW_RET_OK) {
+                    DEBUG_PRINT("Agent not answering after radio loss, rebuilding session\n");
+                    reconnect_stats.rebuilds++;
+                    break;
+                }
+                if (rmw_uros_sync_session(RESUME_SYNC_TIMEOUT_MS) != RMW_RET_OK) {
+                    DEBUG_PRINT("Agent lost the session during radio loss, rebuilding it\n");
+                    reconnect_stats.rebuilds++;
+                    break;
+                }
+                reconnect_stats.resumes++;
+
+#if CRAZYFLIE_TELEMETRY_FRAME
+                telemetry_filter_reset(&telemetry_filter);
+#endif
+                next_pose = xTaskGetTickCount();
+            }
+
+            TickType_t now = xTaskGetTickCount();
+            TickType_t timeout = ((int32_t)(next_pose - now) > 0) ? next_pose - now : 0;
+            sensor_sample_t sample;
+
+            sensor_source_wait(&sensor_source, timeout);
+            while (next_sensor_sample(&sensor_source, &sample)) {
+#if CRAZYFLIE_TELEMETRY_FRAME
+                // A frame carries one weather sample: when several arrive in
+                // one cycle only the latest is sent, with a fresh pose below
+                crazyflie_telemetry_set_weather(&telemetry, sample.temperature, sample.humidity);
+#else
                 std_msgs__msg__Float32 aux_msg;
 
-                aux_msg.data = sensor_topic.echoes.data[0];
+                aux_msg.data = sample.temperature;
                 rc = rcl_publish( &pub_sensors_temp, (const void *) &aux_msg, NULL);
+                RCSOFTCHECK()
 
-                aux_msg.data = sensor_topic.echoes.data[1];
+                aux_msg.data = sample.humidity;
                 rc = rcl_publish( &pub_sensors_hum, (const void *) &aux_msg, NULL);
+                RCSOFTCHECK()
+#endif
+            }
 
-                sensor_data_ready = 0;
+            now = xTaskGetTickCount();
+#if CRAZYFLIE_TELEMETRY_FRAME
+            // A weather sample is sent right away together with a fresh pose
+            if ((int32_t)(now - next_pose) < 0 && !crazyflie_telemetry_has_weather(&telemetry)) {
+                continue;
+            }
+#else
+            if ((int32_t)(now - next_pose) < 0) {
+                continue;
+            }
+#endif
+
+            // Only a due pose moves the deadline; an early, weather-driven
+            // frame leaves it where it is
+            if ((int32_t)(now - next_pose) >= 0) {
+                next_pose += POSE_PERIOD_MS/portTICK_RATE_MS;
+                if ((int32_t)(now - next_pose) >= 0) {
+                    next_pose = now + POSE_PERIOD_MS/portTICK_RATE_MS;
+                }
             }
 
-            pose.x     = logGetFloat(pitchid);
-            pose.y     = logGetFloat(rollid);
-            pose.z     = logGetFloat(yawid);
-            odom.x     = logGetFloat(Xid);
-            odom.y     = logGetFloat(Yid);
-            odom.z     = logGetFloat(Zid);
+            if ((int32_t)(now - next_memory) >= 0) {
+                next_memory = now + MEMORY_PERIOD_MS/portTICK_RATE_MS;
+
+                memory_monitor_sample(&memory_monitor);
+                memory_stats.data.size = memory_monitor.field_count;
+                rc = rcl_publish( &pub_memory, (const void *) &memory_stats, NULL);
+                RCSOFTCHECK()
+            }
+
+#if CRAZYFLIE_TELEMETRY_FRAME
+            float values[6];
+            crazyflie_telemetry_stamp(&telemetry, now * portTICK_RATE_MS);
+            log_snapshot_read_pose(&pose_snapshot, &state);
+            crazyflie_telemetry_set_attitude(&telemetry, state.pitch, state.roll, state.yaw);
+            crazyflie_telemetry_set_position(&telemetry, state.x, state.y, state.z);
+            crazyflie_telemetry_pose_values(&telemetry, values);
+
+            // Weather samples always go out, the filter only decides on pose-only frames
+            if (crazyflie_telemetry_has_weather(&telemetry) ||
+                telemetry_filter_check(&telemetry_filter, values, now * portTICK_RATE_MS,
+                    crazyflie_telemetry_serialized_size(&telemetry))) {
+                rc = rcl_publish( &pub_telemetry, (const void *) &telemetry.msg, NULL);
+                RCSOFTCHECK()
+                if (rc == RCL_RET_OK) {
+                    reconnect_sample_sent();
+                }
+            }
+
+            crazyflie_telemetry_clear_weather(&telemetry);
+#else
+            log_snapshot_read_pose(&pose_snapshot, &state);
+            pose.x     = state.pitch;
+            pose.y     = state.roll;
+            pose.z     = state.yaw;
+            odom.x     = state.x;
+            odom.y     = state.y;
+            odom.z     = state.z;
 
             rc = rcl_publish( &pub_attitude, (const void *) &pose, NULL);
             RCSOFTCHECK()
 
             rc = rcl_publish( &pub_odom, (const void *) &odom, NULL);
             RCSOFTCHECK()
-
-            vTaskDelay(100/portTICK_RATE_MS);
+            if (rc == RCL_RET_OK) {
+                reconnect_sample_sent();
+            }
+#endif
         }
 
+clean1:
+        // The session is rebuilt from scratch, so nothing may stay allocated
+#if CRAZYFLIE_SINGLE_SESSION
+        rc = rcl_wait_set_fini(&wait_set);
+        rc = rcl_subscription_fini(&sub_sensors, &node);
+#endif
+        rc = rcl_publisher_fini(&pub_memory, &node);
+#if CRAZYFLIE_TELEMETRY_FRAME
+        rc = rcl_publisher_fini(&pub_telemetry, &node);
+#else
+        rc = rcl_publisher_fini(&pub_attitude, &node);
+        rc = rcl_publisher_fini(&pub_odom, &node);
+        rc = rcl_publisher_fini(&pub_sensors_hum, &node);
+        rc = rcl_publisher_fini(&pub_sensors_temp, &node);
+#endif
         rc = rcl_node_fini(&node);
-clean1:     
         rc = rcl_shutdown(&context);
+        rc = rcl_context_fini(&context);
         DEBUG_PRINT("Connection lost on primary, retriying\n");
+#if CRAZYFLIE_TELEMETRY_FRAME
+        DEBUG_PRINT("Telemetry: %u frames suppressed, %u bytes saved\n",
+            (unsigned int)telemetry_filter.suppressed, (unsigned int)telemetry_filter.bytes_saved);
+#endif
+#if !CRAZYFLIE_SINGLE_SESSION
+        DEBUG_PRINT("Sensor samples: %u handed over, %u dropped, %u overruns, %u max queued\n",
+            (unsigned int)sensor_ring.pushed, (unsigned int)sensor_ring.dropped,
+            (unsigned int)sensor_overruns, (unsigned int)sensor_ring.high_water);
+#endif
     }
 
     vTaskSuspend( NULL );
 }
 
+#if !CRAZYFLIE_SINGLE_SESSION
 void microros_secondary(void * params){
     while(!created_primary){
         vTaskDelay(100);
@@ -255,11 +637,16 @@ void microros_secondary(void * params){
         DEBUG_PRINT("Free heap pre uROS: %d bytes\n", xPortGetFreeHeapSize());
         vTaskDelay(50);
 
-        rcl_context_t      context;
+        rcl_context_t      context = rcl_get_zero_initialized_context();
         rcl_init_options_t init_options;
         rcl_ret_t          rc;
         rcl_ret_t          rc_aux __attribute__((unused));
 
+        // Zero initialized for clean2, as in the primary task
+        rcl_node_t node = rcl_get_zero_initialized_node();
+        rcl_subscription_t sub_sensors = rcl_get_zero_initialized_subscription();
+        rcl_wait_set_t wait_set = rcl_get_zero_initialized_wait_set();
+
         init_options = rcl_get_zero_initialized_init_options();                          
         rc = rcl_init_options_init(&init_options, rcutils_get_default_allocator());      
         RCCHECK(clean2)
@@ -274,44 +661,23 @@ void microros_secondary(void * params){
             crazyflie_serial_read
         ); 
 
-        context = rcl_get_zero_initialized_context();                                    
-
         rc = rcl_init(0, NULL, &init_options, &context); 
         rc_aux = rcl_init_options_fini(&init_options);
         RCCHECK(clean2)
 
-        rcl_node_t node = rcl_get_zero_initialized_node();
         rcl_node_options_t node_ops = rcl_node_get_default_options();
 
         rc = rcl_node_init(&node, "crazyflie_node_2", "", &context, &node_ops);
         RCCHECK(clean2)
 
         // Create subscription 2
-        const char * echo_topic_name = "Float__Sequence";
-
-        rcl_subscription_t sub_sensors      = rcl_get_zero_initialized_subscription();
-        const rosidl_message_type_support_t * sub_type_support = ROSIDL_GET_MSG_TYPE_SUPPORT(sensor_msgs, msg, LaserEcho);
-        rcl_subscription_options_t subscription_ops = rcl_subscription_get_default_options();
-        subscription_ops.qos.reliability = RMW_QOS_POLICY_RELIABILITY_BEST_EFFORT;
-
-        rc = rcl_subscription_init(
-            &sub_sensors,
-            &node,
-            sub_type_support,
-            echo_topic_name,
-            &subscription_ops);
+        rc = sensor_subscription_init(&sub_sensors, &node);
         RCCHECK(clean2)
 
         // Create wait set
-        rcl_wait_set_t wait_set = rcl_get_zero_initialized_wait_set();
         rc = rcl_wait_set_init(&wait_set, 1, 0, 0, 0, 0, 0, &context, rcl_get_default_allocator());
         RCCHECK(clean2)
 
-        if(rc != RCL_RET_OK){
-            rc_aux = rcl_node_fini(&node);
-        }
-        RCCHECK(clean2)
-
         DEBUG_PRINT("Free heap post uROS configuration: %d bytes\n", xPortGetFreeHeapSize());
         DEBUG_PRINT("uROS Used Memory %d bytes\n", usedMemory);
         DEBUG_PRINT("uROS Absolute Used Memory %d bytes\n", absoluteUsedMemory);
@@ -326,34 +692,29 @@ void microros_secondary(void * params){
             rc = rcl_wait_set_add_subscription(&wait_set, &sub_sensors, NULL);
             RCSOFTCHECK()
 
-            rc = rcl_wait(&wait_set, RCL_MS_TO_NS(10));
+            // Block until a sample arrives, there is nothing else for this task to do
+            rc = rcl_wait(&wait_set, RCL_MS_TO_NS(POSE_PERIOD_MS));
             // RCSOFTCHECK()
 
+            sensor_sample_t sample;
             if (wait_set.subscriptions[0]){
-                sensor_msgs__msg__LaserEcho rcv;
-                float rcv_data[2];
-
-                rcv.echoes.capacity = 2;
-                rcv.echoes.size = 2;
-                rcv.echoes.data = rcv_data;
-
-                rc = rcl_take(&sub_sensors, &rcv, NULL, NULL);
-
-                if (rc == RCL_RET_OK) {
-                    memcpy(&sensor_topic, &rcv, sizeof(sensor_msgs__msg__LaserEcho));
-                    sensor_data_ready = 1;
-                }      
+                if (sensor_take(&sub_sensors, &sample)) {
+                    // A full ring drops the sample and counts it, the primary is woken either way
+                    spsc_ring_push(&sensor_ring, &sample);
+                    xTaskNotifyGive(primary_task);
+                }
             }
-
-            vTaskDelay(100/portTICK_RATE_MS);
         }
 
+clean2:
+        rc = rcl_wait_set_fini(&wait_set);
         rc = rcl_subscription_fini(&sub_sensors, &node);
         rc = rcl_node_fini(&node);
-clean2:     
         rc = rcl_shutdown(&context);
+        rc = rcl_context_fini(&context);
         DEBUG_PRINT("Connection lost on secondary, retriying\n");
     }
 
     vTaskSuspend( NULL );
 }
+#endif
@@ -5,6 +5,7 @@
 #include <rclc/rclc.h>
 #include <rclc/executor.h>
 #include <geometry_msgs/msg/point32.h>
+#include <std_msgs/msg/u_int32_multi_array.h>
 
 #include <rcutils/allocator.h>
 #include <rmw_microros/rmw_microros.h>
@@ -15,18 +16,139 @@
 #include "worker.h"
 #include "num.h"
 #include "debug.h"
+#include "usec_time.h"
+#include "radiolink.h"
 #include <time.h>
 
 #include "microrosapp.h"
 
+#include "../common/crazyflie_telemetry.h"
+#include "../common/telemetry_quant.h"
+#include "../common/crazyflie_log_snapshot.h"
+#include "../common/telemetry_filter.h"
+
+#define PERIODIC_RUNNER_NOW_US() ((uint64_t)usecTimestamp())
+#include "../common/periodic_runner.h"
+
+// The radio transport splits every write into P2P packets of at most
+// P2P_MAX_DATA_SIZE bytes. The buffer is a whole number of packets, so a
+// coalesced write goes out as full packets with one part-filled packet at
+// most, and large enough that a framed telemetry frame (over one packet)
+// still shares its packets with the diagnostics messages.
+#define COALESCING_TRANSPORT_MTU (4 * P2P_MAX_DATA_SIZE)
+#define COALESCING_TRANSPORT_NOW_US() ((uint64_t)usecTimestamp())
+#include "../common/coalescing_transport.h"
+
+#define MEMORY_MONITOR_ALLOCATOR_USED() usedMemory
+#define MEMORY_MONITOR_ALLOCATOR_PEAK() absoluteUsedMemory
+#include "../common/memory_monitor.h"
+
 #define RCCHECK(fn) { rcl_ret_t temp_rc = fn; if((temp_rc != RCL_RET_OK)){printf("Failed status on line %d: %d. Aborting.\n",__LINE__,(int)temp_rc);vTaskDelete(NULL);}}
 #define RCSOFTCHECK(fn) { rcl_ret_t temp_rc = fn; if((temp_rc != RCL_RET_OK)){printf("Failed status on line %d: %d. Continuing.\n",__LINE__,(int)temp_rc);}}
 
+// 1: attitude and position go out together as one telemetry frame
+// 0: separate Point32 messages on /drone/attitude and /drone/odometry
+#ifndef CRAZYFLIE_TELEMETRY_FRAME
+#define CRAZYFLIE_TELEMETRY_FRAME 1
+#endif
+
+// 1: frames are sent as int16 fixed point on TELEMETRY_QUANT_TOPIC instead,
+//    telemetry_decoder republishes them as float frames on the host
+#ifndef CRAZYFLIE_TELEMETRY_QUANTIZED
+#define CRAZYFLIE_TELEMETRY_QUANTIZED 0
+#endif
+
+// 1: telemetry goes out on best-effort streams, telemetry frames (float or
+//    quantized) carry a sequence number so the receiver can count drops.
+//    The separate Point32 messages have no room for one, with
+//    CRAZYFLIE_TELEMETRY_FRAME 0 drops cannot be counted.
+// 0: reliable streams, a lost packet is retransmitted and blocks the ones behind it
+#ifndef CRAZYFLIE_STREAMING
+#define CRAZYFLIE_STREAMING 1
+#endif
+
+#if CRAZYFLIE_STREAMING
+#define TELEMETRY_PUBLISHER_INIT rclc_publisher_init_best_effort
+#else
+#define TELEMETRY_PUBLISHER_INIT rclc_publisher_init_default
+#endif
+
+// 1: XRCE messages are packed into shared radio writes, flushed at the end of
+//    every loop cycle, before each read and, when the next message is
+//    written, after COALESCE_DEADLINE_US
+// 0: every message is its own radio write
+#ifndef CRAZYFLIE_COALESCE_WRITES
+#define CRAZYFLIE_COALESCE_WRITES 1
+#endif
+
+#define COALESCE_DEADLINE_US 2000
+
+// A publish call taking longer than this counts as a head-of-line stall
+#define STREAM_STALL_US 2000
+#define STREAM_STATS_PERIOD_MS 10000
+
+typedef struct stream_stats_t {
+    uint32_t seq;
+    uint32_t sent;
+    uint32_t errors;
+    uint32_t stalls;
+    uint32_t max_publish_us;
+} stream_stats_t;
+
+stream_stats_t stream_stats;
+
+#if CRAZYFLIE_TELEMETRY_FRAME
+// Frames are only sent when the pose moved past the deadband (degrees for
+// attitude, meters for position), at most every MIN and at least every MAX ms
+#define TELEMETRY_DEADBAND_ATTITUDE 0.5f
+#define TELEMETRY_DEADBAND_POSITION 0.005f
+#define TELEMETRY_MIN_INTERVAL_MS 10
+#define TELEMETRY_MAX_INTERVAL_MS 500
+
+rcl_publisher_t publisher_telemetry;
+crazyflie_telemetry_t telemetry;
+telemetry_filter_t telemetry_filter;
+#if CRAZYFLIE_TELEMETRY_QUANTIZED
+telemetry_quant_t telemetry_q;
+#endif
+#else
 rcl_publisher_t publisher_odometry;
 rcl_publisher_t publisher_attitude;
+#endif
+
+static log_snapshot_t pose_snapshot;
 
-static int pitchid, rollid, yawid;
-static int Xid, Yid, Zid;
+// Main loop period and how often its diagnostics are published
+#define LOOP_PERIOD_MS 10
+#define LOOP_STATS_CYCLES 100
+
+rcl_publisher_t publisher_loop_stats;
+std_msgs__msg__UInt32MultiArray loop_stats;
+uint32_t loop_stats_buffer[PERIODIC_RUNNER_DIAG_FIELDS];
+periodic_runner_t loop_runner;
+
+rcl_publisher_t publisher_memory;
+std_msgs__msg__UInt32MultiArray memory_stats;
+memory_monitor_t memory_monitor;
+
+// Publishes a telemetry sample and accounts for failed and blocking publications
+static void stream_publish(const rcl_publisher_t * publisher, const void * msg){
+    uint32_t start = usecTimestamp();
+    rcl_ret_t rc = rcl_publish(publisher, msg, NULL);
+    uint32_t elapsed = usecTimestamp() - start;
+
+    if (rc == RCL_RET_OK) {
+        stream_stats.sent++;
+    } else {
+        stream_stats.errors++;
+    }
+    if (elapsed > STREAM_STALL_US) {
+        stream_stats.stalls++;
+    }
+    if (elapsed > stream_stats.max_publish_us) {
+        stream_stats.max_publish_us = elapsed;
+    }
+}
 
 float sign(float x){
     return (x >= 0) ? 1.0 : -1.0;
@@ -59,6 +181,23 @@ void appMain(){
     }
 
     const uint8_t radio_channel = 65;
+#if CRAZYFLIE_COALESCE_WRITES
+    coalescing_transport_install(
+        crazyflie_serial_open,
+        crazyflie_serial_close,
+        crazyflie_serial_write,
+        crazyflie_serial_read,
+        COALESCE_DEADLINE_US,
+        0);
+    rmw_uros_set_custom_transport(
+        true,
+        (void *) &radio_channel,
+        coalescing_transport_open,
+        coalescing_transport_close,
+        coalescing_transport_write,
+        coalescing_transport_read
+    );
+#else
     rmw_uros_set_custom_transport( 
         true, 
         (void *) &radio_channel, 
@@ -67,6 +206,7 @@ void appMain(){
         crazyflie_serial_write, 
         crazyflie_serial_read
     ); 
+#endif
 
     rcl_allocator_t allocator = rcl_get_default_allocator();
 	rclc_support_t support;
@@ -79,10 +219,29 @@ void appMain(){
 	RCCHECK(rclc_node_init_default(&node, "crazyflie_node", "", &support));
 
 	// create publishers
-    // TODO (pablogs9): these publishers must be best effort
-	RCCHECK(rclc_publisher_init_default(&publisher_odometry, &node,
+#if CRAZYFLIE_TELEMETRY_FRAME
+#if CRAZYFLIE_TELEMETRY_QUANTIZED
+	RCCHECK(TELEMETRY_PUBLISHER_INIT(&publisher_telemetry, &node,
+        ROSIDL_GET_MSG_TYPE_SUPPORT(std_msgs, msg, Int16MultiArray), TELEMETRY_QUANT_TOPIC));
+
+    telemetry_quant_init(&telemetry_q);
+#else
+	RCCHECK(TELEMETRY_PUBLISHER_INIT(&publisher_telemetry, &node,
+        ROSIDL_GET_MSG_TYPE_SUPPORT(geometry_msgs, msg, PolygonStamped), CRAZYFLIE_TELEMETRY_TOPIC));
+#endif
+
+    // Init messages
+    crazyflie_telemetry_init(&telemetry);
+
+    const float deadband[6] = {
+        TELEMETRY_DEADBAND_ATTITUDE, TELEMETRY_DEADBAND_ATTITUDE, TELEMETRY_DEADBAND_ATTITUDE,
+        TELEMETRY_DEADBAND_POSITION, TELEMETRY_DEADBAND_POSITION, TELEMETRY_DEADBAND_POSITION
+    };
+    telemetry_filter_init(&telemetry_filter, 6, deadband, TELEMETRY_MIN_INTERVAL_MS, TELEMETRY_MAX_INTERVAL_MS);
+#else
+	RCCHECK(TELEMETRY_PUBLISHER_INIT(&publisher_odometry, &node,
         ROSIDL_GET_MSG_TYPE_SUPPORT(geometry_msgs, msg, Point32), "/drone/odometry"));
-	RCCHECK(rclc_publisher_init_default(&publisher_attitude, &node,
+	RCCHECK(TELEMETRY_PUBLISHER_INIT(&publisher_attitude, &node,
         ROSIDL_GET_MSG_TYPE_SUPPORT(geometry_msgs, msg, Point32), "/drone/attitude"));
 
     // // Init messages
@@ -90,38 +249,137 @@ void appMain(){
     geometry_msgs__msg__Point32__init(&pose);
     geometry_msgs__msg__Point32 odom;
     geometry_msgs__msg__Point32__init(&odom);
+#endif
+
+    // Loop diagnostics: cycles, overruns, jitter mean/max, execution p50/p99/max (us)
+	RCCHECK(rclc_publisher_init_best_effort(&publisher_loop_stats, &node,
+        ROSIDL_GET_MSG_TYPE_SUPPORT(std_msgs, msg, UInt32MultiArray), "/drone/loop_stats"));
+
+    loop_stats.layout.dim.data = NULL;
+    loop_stats.layout.dim.size = 0;
+    loop_stats.layout.dim.capacity = 0;
+    loop_stats.layout.data_offset = 0;
+    loop_stats.data.data = loop_stats_buffer;
+    loop_stats.data.size = PERIODIC_RUNNER_DIAG_FIELDS;
+    loop_stats.data.capacity = PERIODIC_RUNNER_DIAG_FIELDS;
 
-    //Get pitch, roll and yaw value
-    pitchid = logGetVarId("stateEstimate", "pitch");
-    rollid = logGetVarId("stateEstimate", "roll");
-    yawid = logGetVarId("stateEstimate", "yaw");
+    // Memory diagnostics, sampled together with the loop diagnostics
+	RCCHECK(rclc_publisher_init_best_effort(&publisher_memory, &node,
+        ROSIDL_GET_MSG_TYPE_SUPPORT(std_msgs, msg, UInt32MultiArray), "/drone/memory"));
 
-    //Get X,Y and Z value
-    Xid = logGetVarId("stateEstimate", "x");
-    Yid = logGetVarId("stateEstimate", "y");
-    Zid = logGetVarId("stateEstimate", "z");
+    memory_monitor_init(&memory_monitor);
+    memory_monitor_add_task(&memory_monitor, NULL);
+
+    memory_stats.layout.dim.data = NULL;
+    memory_stats.layout.dim.size = 0;
+    memory_stats.layout.dim.capacity = 0;
+    memory_stats.layout.data_offset = 0;
+    memory_stats.data.data = memory_monitor.fields;
+    memory_stats.data.size = 0;
+    memory_stats.data.capacity = MEMORY_MONITOR_MAX_FIELDS;
+
+    //Get pitch, roll, yaw and X, Y, Z values as one snapshot group
+    log_snapshot_init(&pose_snapshot);
+    if (!log_snapshot_add_pose(&pose_snapshot)) {
+        DEBUG_PRINT("Missing stateEstimate log variables (line %d)\n",__LINE__);
+    }
+    crazyflie_pose_t state;
 
     DEBUG_PRINT("Free heap post uROS configuration: %d bytes\n", xPortGetFreeHeapSize());
     DEBUG_PRINT("uROS Used Memory %d bytes\n", usedMemory);
     DEBUG_PRINT("uROS Absolute Used Memory %d bytes\n", absoluteUsedMemory);
 
+    uint32_t stats_ms = xTaskGetTickCount() * portTICK_RATE_MS;
+    periodic_runner_init(&loop_runner, LOOP_PERIOD_MS);
+
 	while(1){
-        pose.x     = logGetFloat(pitchid);
-        pose.y     = logGetFloat(rollid);
-        pose.z     = logGetFloat(yawid);
-        odom.x     = logGetFloat(Xid);
-        odom.y     = logGetFloat(Yid);
-        odom.z     = logGetFloat(Zid);
+        // Runs on a fixed 10 ms grid, however long the previous iteration took
+        periodic_runner_wait(&loop_runner);
+
+        if (loop_runner.cycles % LOOP_STATS_CYCLES == 0) {
+            periodic_runner_diagnostics(&loop_runner, loop_stats_buffer);
+            RCSOFTCHECK(rcl_publish( &publisher_loop_stats, (const void *) &loop_stats, NULL));
+
+            memory_monitor_sample(&memory_monitor);
+            memory_stats.data.size = memory_monitor.field_count;
+            RCSOFTCHECK(rcl_publish( &publisher_memory, (const void *) &memory_stats, NULL));
+        }
+
+#if CRAZYFLIE_TELEMETRY_FRAME
+        uint32_t now_ms = xTaskGetTickCount() * portTICK_RATE_MS;
+        float values[6];
+
+        crazyflie_telemetry_stamp(&telemetry, now_ms);
+        log_snapshot_read_pose(&pose_snapshot, &state);
+        crazyflie_telemetry_set_attitude(&telemetry, state.pitch, state.roll, state.yaw);
+        crazyflie_telemetry_set_position(&telemetry, state.x, state.y, state.z);
+        crazyflie_telemetry_pose_values(&telemetry, values);
+
+#if CRAZYFLIE_TELEMETRY_QUANTIZED
+        if (telemetry_filter_check(&telemetry_filter, values, now_ms, telemetry_quant_serialized_size(&telemetry_q))) {
+            telemetry_quant_encode(&telemetry_q, now_ms, stream_stats.seq, values);
+            stream_publish(&publisher_telemetry, &telemetry_q.msg);
+            stream_stats.seq++;
+        }
+#else
+#if CRAZYFLIE_STREAMING
+        crazyflie_telemetry_set_seq(&telemetry, stream_stats.seq);
+#endif
+        if (telemetry_filter_check(&telemetry_filter, values, now_ms, crazyflie_telemetry_serialized_size(&telemetry))) {
+            stream_publish(&publisher_telemetry, &telemetry.msg);
+            stream_stats.seq++;
+        }
+#endif
+
+#else
+        log_snapshot_read_pose(&pose_snapshot, &state);
+        pose.x     = state.pitch;
+        pose.y     = state.roll;
+        pose.z     = state.yaw;
+        odom.x     = state.x;
+        odom.y     = state.y;
+        odom.z     = state.z;
+
+        stream_publish(&publisher_attitude, &pose);
 
-        RCSOFTCHECK(rcl_publish( &publisher_attitude, (const void *) &pose, NULL));
+        stream_publish(&publisher_odometry, &odom);
+#endif
 
-        RCSOFTCHECK(rcl_publish( &publisher_odometry, (const void *) &odom, NULL));
+#if CRAZYFLIE_COALESCE_WRITES
+        // Everything published in this cycle leaves in as few radio writes as fit
+        coalescing_transport_flush();
+#endif
 
-        vTaskDelay(10/portTICK_RATE_MS);
+        uint32_t stats_now_ms = xTaskGetTickCount() * portTICK_RATE_MS;
+        if (stats_now_ms - stats_ms >= STREAM_STATS_PERIOD_MS) {
+#if CRAZYFLIE_TELEMETRY_FRAME
+            DEBUG_PRINT("Telemetry: %u samples, %u sent (%u heartbeats), %u suppressed, %u bytes sent, %u bytes saved\n",
+                (unsigned int)telemetry_filter.offered, (unsigned int)telemetry_filter.published,
+                (unsigned int)telemetry_filter.heartbeats, (unsigned int)telemetry_filter.suppressed,
+                (unsigned int)telemetry_filter.bytes_sent, (unsigned int)telemetry_filter.bytes_saved);
+#endif
+            DEBUG_PRINT("Stream: %u published, %u failed, %u stalls > %u us, slowest publish %u us\n",
+                (unsigned int)stream_stats.sent, (unsigned int)stream_stats.errors,
+                (unsigned int)stream_stats.stalls, (unsigned int)STREAM_STALL_US,
+                (unsigned int)stream_stats.max_publish_us);
+#if CRAZYFLIE_COALESCE_WRITES
+            coalescing_transport_stats_t link = coalescing_transport_get_stats();
+            DEBUG_PRINT("Link: %u messages in %u radio writes, %u bytes, %u short writes\n",
+                (unsigned int)link.messages, (unsigned int)link.writes,
+                (unsigned int)link.bytes, (unsigned int)link.errors);
+#endif
+            stats_ms = stats_now_ms;
+        }
 	}
 
+#if CRAZYFLIE_TELEMETRY_FRAME
+	RCCHECK(rcl_publisher_fini(&publisher_telemetry, &node))
+#else
 	RCCHECK(rcl_publisher_fini(&publisher_attitude, &node))
 	RCCHECK(rcl_publisher_fini(&publisher_odometry, &node))
+#endif
+	RCCHECK(rcl_publisher_fini(&publisher_loop_stats, &node))
+	RCCHECK(rcl_publisher_fini(&publisher_memory, &node))
 	RCCHECK(rcl_node_fini(&node))
 
     vTaskSuspend( NULL );
@@ -0,0 +1,144 @@
+// Host entry point: runs one app's appMain() as a POSIX process.
+//
+// appMain() runs in its own thread so that vTaskDelete(NULL), which the
+// apps call when they are done or have failed, only ends that thread; the
+// process exits when it does.
+//
+// Transport, chosen when configuring host/CMakeLists.txt:
+//   udp     (default) the micro-ROS client library's own UDP transport; the
+//           agent address is fixed when micro-ROS is built for the host
+//           (RMW_UXRCE_DEFAULT_UDP_IP / RMW_UXRCE_DEFAULT_UDP_PORT):
+//             micro_ros_agent udp4 --port 8888
+//   serial  a custom transport over a serial device or pseudo terminal,
+//           given as the first argument or MICRO_ROS_SERIAL_DEV. A pty
+//           pair stands in for a radio link on a workstation:
+//             socat -d -d pty,raw,echo=0 pty,raw,echo=0
+//             micro_ros_agent serial --dev /dev/pts/N
+//             ./pub_sub_one /dev/pts/M
+//           With HOST_COALESCE_WRITES the writes go through
+//           common/coalescing_transport.h, as on the Crazyflie.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+#ifdef HOST_TRANSPORT_SERIAL
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <rmw_microros/rmw_microros.h>
+#include <uxr/client/profile/transport/custom/custom_transport.h>
+
+#ifdef HOST_COALESCE_WRITES
+#include "../common/coalescing_transport.h"
+
+// Flush a lone message after 1 ms
+#define HOST_COALESCE_DEADLINE_US 1000
+#endif
+#endif
+
+void appMain(void * arg);
+
+#ifdef HOST_TRANSPORT_SERIAL
+static int serial_fd = -1;
+
+static bool host_serial_open(struct uxrCustomTransport * transport)
+{
+	const char * device = (const char *)transport->args;
+	struct termios tty;
+
+	serial_fd = open(device, O_RDWR | O_NOCTTY);
+	if (serial_fd < 0) {
+		perror(device);
+		return false;
+	}
+
+	if (tcgetattr(serial_fd, &tty) == 0) {
+		cfmakeraw(&tty);
+		cfsetispeed(&tty, B115200);
+		cfsetospeed(&tty, B115200);
+		tcsetattr(serial_fd, TCSANOW, &tty);
+	}
+	return true;
+}
+
+static bool host_serial_close(struct uxrCustomTransport * transport)
+{
+	(void)transport;
+	bool ok = close(serial_fd) == 0;
+	serial_fd = -1;
+	return ok;
+}
+
+static size_t host_serial_write(struct uxrCustomTransport * transport, const uint8_t * buf, size_t len, uint8_t * errcode)
+{
+	(void)transport;
+	ssize_t written = write(serial_fd, buf, len);
+
+	if (written < 0) {
+		*errcode = 1;
+		return 0;
+	}
+	*errcode = 0;
+	return (size_t)written;
+}
+
+static size_t host_serial_read(struct uxrCustomTransport * transport, uint8_t * buf, size_t len, int timeout, uint8_t * errcode)
+{
+	(void)transport;
+	struct pollfd fds = {serial_fd, POLLIN, 0};
+
+	*errcode = 0;
+	if (poll(&fds, 1, timeout) <= 0) {
+		return 0;
+	}
+
+	ssize_t received = read(serial_fd, buf, len);
+	if (received < 0) {
+		*errcode = 1;
+		return 0;
+	}
+	return (size_t)received;
+}
+#endif
+
+static void * app_thread(void * arg)
+{
+	appMain(arg);
+	return NULL;
+}
+
+int main(int argc, char ** argv)
+{
+	pthread_t thread;
+
+#ifdef HOST_TRANSPORT_SERIAL
+	const char * device = (argc > 1) ? argv[1] : getenv("MICRO_ROS_SERIAL_DEV");
+	if (device == NULL) {
+		fprintf(stderr, "usage: %s <serial device>, or set MICRO_ROS_SERIAL_DEV\n", argv[0]);
+		return 1;
+	}
+
+#ifdef HOST_COALESCE_WRITES
+	coalescing_transport_install(host_serial_open, host_serial_close, host_serial_write, host_serial_read,
+		HOST_COALESCE_DEADLINE_US, 0);
+	rmw_uros_set_custom_transport(true, (void *)device, coalescing_transport_open, coalescing_transport_close,
+		coalescing_transport_write, coalescing_transport_read);
+#else
+	rmw_uros_set_custom_transport(true, (void *)device, host_serial_open, host_serial_close,
+		host_serial_write, host_serial_read);
+#endif
+#else
+	(void)argc;
+	(void)argv;
+#endif
+
+	if (pthread_create(&thread, NULL, app_thread, NULL) != 0) {
+		perror("pthread_create");
+		return 1;
+	}
+	pthread_join(thread, NULL);
+	return 0;
+}
@@ -0,0 +1,129 @@
+#ifndef HOST_SHIM_H_
+#define HOST_SHIM_H_
+
+// Thin FreeRTOS / ESP-IDF / Zephyr stand-in for running the apps on POSIX.
+//
+// Force-included into every app built by host/CMakeLists.txt. It covers
+// only what the apps call outside their #ifdef ESP_PLATFORM blocks: task
+// delete/suspend of the calling task, delay and create, the tick counter
+// and printk. A task is a
+// pthread and a tick is one millisecond. INC_FREERTOS_H is deliberately
+// left undefined, so the common/ headers take their POSIX paths
+// (CLOCK_MONOTONIC, clock_nanosleep, mallinfo) and measure the host
+// rather than an emulated RTOS.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+
+typedef pthread_t * TaskHandle_t;
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS pdTRUE
+
+#define configTICK_RATE_HZ 1000
+#define portTICK_PERIOD_MS 1
+#define portTICK_RATE_MS portTICK_PERIOD_MS
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+
+#define printk printf
+
+static inline TickType_t xTaskGetTickCount(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (TickType_t)((uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+}
+
+static inline void vTaskDelay(TickType_t ticks)
+{
+	usleep((useconds_t)ticks * 1000);
+}
+
+// Tasks are detached threads, so another task can be neither deleted nor
+// suspended through its handle; an app that tries is stopped here rather
+// than left running with a task that was meant to be gone
+static inline void host_task_unsupported(const char * call)
+{
+	fprintf(stderr, "host shim: %s on another task is not supported\n", call);
+	abort();
+}
+
+// Ending the calling task ends its thread; host/main.c exits once appMain's thread is gone
+static inline void vTaskDelete(TaskHandle_t task)
+{
+	if (task != NULL) {
+		host_task_unsupported("vTaskDelete");
+	}
+	pthread_exit(NULL);
+}
+
+// A suspended task is never resumed by the apps, so suspending itself ends the thread
+static inline void vTaskSuspend(TaskHandle_t task)
+{
+	if (task != NULL) {
+		host_task_unsupported("vTaskSuspend");
+	}
+	pthread_exit(NULL);
+}
+
+typedef void (*TaskFunction_t)(void *);
+
+typedef struct host_task_start_t {
+	TaskFunction_t function;
+	void * arg;
+} host_task_start_t;
+
+static inline void * host_task_trampoline(void * arg)
+{
+	host_task_start_t start = *(host_task_start_t *)arg;
+	free(arg);
+	start.function(start.arg);
+	return NULL;
+}
+
+// Stack size and priority are ignored. The thread is created detached, so it
+// releases its resources when it ends; the handle is heap allocated and
+// never freed
+static inline BaseType_t xTaskCreate(TaskFunction_t function, const char * name, uint32_t stack,
+	void * arg, UBaseType_t priority, TaskHandle_t * handle)
+{
+	(void)name;
+	(void)stack;
+	(void)priority;
+
+	host_task_start_t * start = (host_task_start_t *)malloc(sizeof(host_task_start_t));
+	pthread_t * thread = (pthread_t *)malloc(sizeof(pthread_t));
+	if (start == NULL || thread == NULL) {
+		free(start);
+		free(thread);
+		return pdFALSE;
+	}
+
+	pthread_attr_t attr;
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+
+	start->function = function;
+	start->arg = arg;
+	int rc = pthread_create(thread, &attr, host_task_trampoline, start);
+	pthread_attr_destroy(&attr);
+	if (rc != 0) {
+		free(start);
+		free(thread);
+		return pdFALSE;
+	}
+	if (handle != NULL) {
+		*handle = thread;
+	}
+	return pdPASS;
+}
+
+#endif /* HOST_SHIM_H_ */
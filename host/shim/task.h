@@ -0,0 +1,2 @@
+// FreeRTOS stand-in for host builds, see host_shim.h
+#include "host_shim.h"
@@ -13,6 +13,8 @@
 #include "freertos/task.h"
 #endif
 
+#include "../common/executor_loop.h"
+
 #define RCCHECK(fn) { rcl_ret_t temp_rc = fn; if((temp_rc != RCL_RET_OK)){printf("Failed status on line %d: %d. Aborting.\n",__LINE__,(int)temp_rc);vTaskDelete(NULL);}}
 #define RCSOFTCHECK(fn) { rcl_ret_t temp_rc = fn; if((temp_rc != RCL_RET_OK)){printf("Failed status on line %d: %d. Continuing.\n",__LINE__,(int)temp_rc);}}
 
@@ -62,10 +64,7 @@ void appMain(void * arg)
 
 	msg.data = 0;
 
-	while(1){
-		rclc_executor_spin_some(&executor, RCL_MS_TO_NS(100));
-		usleep(100000);
-	}
+	executor_loop_run(&executor, NULL);
 
 	// free resources
 	RCCHECK(rcl_publisher_fini(&publisher, &node))
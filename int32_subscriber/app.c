@@ -7,6 +7,9 @@
 
 #include <stdio.h>
 
+#include "../common/executor_loop.h"
+#include "../common/subscription_drain.h"
+
 #define RCCHECK(fn) { rcl_ret_t temp_rc = fn; if((temp_rc != RCL_RET_OK)){printf("Failed status on line %d: %d. Aborting.\n",__LINE__,(int)temp_rc);vTaskDelete(NULL);}}
 #define RCSOFTCHECK(fn) { rcl_ret_t temp_rc = fn; if((temp_rc != RCL_RET_OK)){printf("Failed status on line %d: %d. Continuing.\n",__LINE__,(int)temp_rc);}}
 
@@ -41,12 +44,11 @@ void appMain(void * arg)
 	// create executor
 	rclc_executor_t executor;
 	RCCHECK(rclc_executor_init(&executor, &support.context, 1, &allocator));
-	RCCHECK(rclc_executor_add_subscription(&executor, &subscriber, &msg, &subscription_callback, ON_NEW_DATA));
+	// take every queued sample in one spin, not just the first one; the
+	// queue is RMW_UXRCE_MAX_HISTORY=4 deep, set in app-colcon.meta
+	RCCHECK(subscription_drain_add(&executor, &subscriber, &msg, &subscription_callback));
 
-	while(1){
-			rclc_executor_spin_some(&executor, RCL_MS_TO_NS(100));
-			usleep(100000);
-	}
+	executor_loop_run(&executor, NULL);
 
 	// free resources
 	RCCHECK(rcl_subscription_fini(&subscriber, &node));
@@ -4,12 +4,30 @@
 #include <rclc/executor.h>
 
 #include <sensor_msgs/msg/joint_state.h>
+#include <sensor_msgs/msg/detail/joint_state__rosidl_typesupport_introspection_c.h>
 #include <stdio.h>
 
 #include "FreeRTOS.h"
 
-#define ARRAY_LEN 200
-#define JOINT_DOUBLE_LEN 20
+#include "../common/message_memory.h"
+#include "../common/joint_pipeline.h"
+#include "../common/joint_name_cache.h"
+#include "../common/xrce_fragments.h"
+
+// Message bounds; every buffer of joint_states_msg is carved out of
+// joint_states_arena according to them
+#define JOINT_MAX_COUNT 20
+#define JOINT_NAME_LEN 32
+#define FRAME_ID_LEN 32
+#define JOINT_STATES_ARENA_SIZE 2048
+
+// A full JointState is several transport MTUs long and arrives in fragments,
+// reassembled in the reliable input stream. Keep in line with the micro-ROS
+// client build and RMW_UXRCE_STREAM_HISTORY in app-colcon.meta.
+#ifndef JOINT_STATES_TRANSPORT_MTU
+#define JOINT_STATES_TRANSPORT_MTU 512
+#endif
+#define JOINT_STATES_STREAM_HISTORY 8
 
 #define RCCHECK(fn) { rcl_ret_t temp_rc = fn; if((temp_rc != RCL_RET_OK)){printf("Failed status on line %d: %d. Aborting.\n",__LINE__,(int)temp_rc); return 1;}}
 #define RCSOFTCHECK(fn) { rcl_ret_t temp_rc = fn; if((temp_rc != RCL_RET_OK)){printf("Failed status on line %d: %d. Continuing.\n",__LINE__,(int)temp_rc);}}
@@ -17,9 +35,79 @@
 rcl_subscription_t joint_states_subscriber;
 sensor_msgs__msg__JointState joint_states_msg;
 
+static const message_memory_rule_t joint_states_rules[] = {
+	{"header.frame_id", 0, FRAME_ID_LEN},
+	{"name", JOINT_MAX_COUNT, JOINT_NAME_LEN},
+};
+
+static const message_memory_bounds_t joint_states_bounds = {
+	JOINT_MAX_COUNT,
+	JOINT_NAME_LEN,
+	joint_states_rules,
+	sizeof(joint_states_rules) / sizeof(joint_states_rules[0]),
+};
+
+static uint8_t joint_states_arena[JOINT_STATES_ARENA_SIZE] __attribute__((aligned(MESSAGE_MEMORY_ALIGN)));
+
+// Filter weight of a new sample, velocity clamp (rad/s) and position range (rad)
+#define JOINT_FILTER_ALPHA 0.2f
+#define JOINT_VELOCITY_LIMIT 2.0f
+#define JOINT_POSITION_MIN -3.14f
+#define JOINT_POSITION_MAX 3.14f
+
+static joint_pipeline_t joint_pipeline;
+
+// Joints keep the slot of the order they were first seen in, the pipeline
+// state is per slot
+static joint_name_cache_t joint_names;
+static double joint_position[JOINT_NAME_CACHE_MAX_SLOTS];
+static double joint_velocity[JOINT_NAME_CACHE_MAX_SLOTS];
+static double joint_effort[JOINT_NAME_CACHE_MAX_SLOTS];
+
 void subscription_joint_state_callback(const void *msgin){
 	const sensor_msgs__msg__JointState *msg = (const sensor_msgs__msg__JointState *)msgin;
-	printf("I get joint_state topic msg.pos: %d \r\n", (int)(msg->position.data[0] * 100));
+	size_t count = msg->name.size;
+	if (msg->position.size == 0 || count == 0) {
+		return;
+	}
+
+	// Only hashes the names unless they changed since the last message
+	uint32_t rebuilds = joint_names.rebuilds;
+	joint_name_cache_update(&joint_names, msg->name.data, &count);
+	if (joint_names.rebuilds != rebuilds) {
+		printf("Joint order changed: %u names, %u slots\r\n", (unsigned int)count, (unsigned int)joint_names.slot_count);
+		// The slot buffers may be behind after messages that went straight in
+		for (size_t s = 0; s < joint_pipeline.count; s++) {
+			joint_position[s] = joint_pipeline_get(joint_pipeline.position, s);
+			joint_velocity[s] = joint_pipeline_get(joint_pipeline.velocity, s);
+			joint_effort[s] = joint_pipeline_get(joint_pipeline.effort, s);
+		}
+	}
+
+	if (joint_names.identity && count == joint_names.slot_count) {
+		// Message order is slot order
+		joint_pipeline_load(&joint_pipeline, count,
+			msg->position.data, msg->position.size,
+			msg->velocity.data, msg->velocity.size,
+			msg->effort.data, msg->effort.size);
+	} else {
+		// Joints missing from this message keep their last values, joints
+		// without a velocity or effort get 0 as on the identity path
+		joint_name_cache_scatter(&joint_names, msg->position.data, msg->position.size, joint_position);
+		joint_name_cache_scatter(&joint_names, msg->velocity.data, msg->velocity.size, joint_velocity);
+		joint_name_cache_scatter(&joint_names, msg->effort.data, msg->effort.size, joint_effort);
+		joint_pipeline_load(&joint_pipeline, joint_names.slot_count,
+			joint_position, joint_names.slot_count,
+			joint_velocity, joint_names.slot_count,
+			joint_effort, joint_names.slot_count);
+	}
+	joint_pipeline_result_t result = joint_pipeline_process(&joint_pipeline);
+
+	if (result.out_of_range | result.clamped | result.nan) {
+		printf("Joint flags: out of range 0x%08x clamped 0x%08x NaN 0x%08x\r\n",
+			(unsigned int)result.out_of_range, (unsigned int)result.clamped, (unsigned int)result.nan);
+	}
+	printf("I get joint_state topic msg.pos: %d \r\n", (int)(joint_pipeline_get(joint_pipeline.filtered_position, 0) * 100));
 }
 
 int appMain(void *argument)
@@ -35,7 +123,7 @@ int appMain(void *argument)
 	rcl_node_t node;
 	RCCHECK(rclc_node_init_default(&node, "string_node", "", &support));
 
-	// create joint_state subscriber
+	// create joint_state subscriber, reliable: best effort would drop every fragmented message
 	RCCHECK(rclc_subscription_init_default(
 		&joint_states_subscriber,
 		&node,
@@ -47,37 +135,29 @@ int appMain(void *argument)
 	RCCHECK(rclc_executor_init(&executor, &support.context, 1, &allocator));
 	RCCHECK(rclc_executor_add_subscription(&executor, &joint_states_subscriber, &joint_states_msg, &subscription_joint_state_callback, ON_NEW_DATA));
 
-	char joint_states_msg_buffer[ARRAY_LEN];
-	joint_states_msg.header.frame_id.data = joint_states_msg_buffer;
-	joint_states_msg.header.frame_id.size = 20;
-	joint_states_msg.header.frame_id.capacity = ARRAY_LEN;
-
-	rosidl_runtime_c__String string_buffer[JOINT_DOUBLE_LEN];
-	joint_states_msg.name.data = string_buffer;
-	joint_states_msg.name.size = 0;
-	joint_states_msg.name.capacity = JOINT_DOUBLE_LEN;
-
-	for(int i = 0; i < JOINT_DOUBLE_LEN; i++){
-		joint_states_msg.name.data[i].data = (char*) malloc(ARRAY_LEN);
-		joint_states_msg.name.data[i].size = 0;
-		joint_states_msg.name.data[i].capacity = ARRAY_LEN;
+	// Lay out the message memory statically, in one arena
+	const rosidl_message_type_support_t * joint_states_type = MESSAGE_MEMORY_TYPE_SUPPORT(sensor_msgs, msg, JointState);
+	size_t joint_states_size = message_memory_size(joint_states_type, &joint_states_bounds);
+	if (!message_memory_init(joint_states_type, &joint_states_bounds, &joint_states_msg, joint_states_arena, sizeof(joint_states_arena))) {
+		printf("JointState needs %u bytes, arena has %u. Aborting.\n",
+			(unsigned int)joint_states_size, (unsigned int)sizeof(joint_states_arena));
+		return 1;
 	}
+	printf("JointState arena: %u of %u bytes\n", (unsigned int)joint_states_size, (unsigned int)sizeof(joint_states_arena));
+
+	// The largest message the arena takes has to fit the reassembly buffer too
+	size_t joint_states_serialized = message_memory_serialized_size(joint_states_type, &joint_states_bounds);
+	size_t joint_states_fragments = xrce_fragments_count(joint_states_serialized, JOINT_STATES_TRANSPORT_MTU);
+	printf("JointState up to %u bytes serialized, %u fragments of %u\n",
+		(unsigned int)joint_states_serialized, (unsigned int)joint_states_fragments, (unsigned int)JOINT_STATES_STREAM_HISTORY);
+	if (!xrce_fragments_fit(joint_states_serialized, JOINT_STATES_TRANSPORT_MTU, JOINT_STATES_STREAM_HISTORY)) {
+		printf("JointState messages over %u bytes will be dropped\n",
+			(unsigned int)xrce_fragments_max_payload(JOINT_STATES_TRANSPORT_MTU, JOINT_STATES_STREAM_HISTORY));
+	}
+
+	joint_pipeline_init(&joint_pipeline, JOINT_FILTER_ALPHA, JOINT_VELOCITY_LIMIT, JOINT_POSITION_MIN, JOINT_POSITION_MAX);
+	joint_name_cache_init(&joint_names, NULL, 0);
 
-	double joint_states_position_buffer[JOINT_DOUBLE_LEN];
-	joint_states_msg.position.data = joint_states_position_buffer;
-	joint_states_msg.position.size= 7;
-	joint_states_msg.position.capacity = JOINT_DOUBLE_LEN;
-
-	double joint_states_velocity_buffer[JOINT_DOUBLE_LEN];	
-	joint_states_msg.velocity.data = joint_states_velocity_buffer;
-	joint_states_msg.velocity.size = 7;
-	joint_states_msg.velocity.capacity = JOINT_DOUBLE_LEN;
-	
-	double joint_states_effort_buffer[JOINT_DOUBLE_LEN];	
-	joint_states_msg.effort.data = joint_states_effort_buffer;
-	joint_states_msg.effort.size = 7;
-	joint_states_msg.effort.capacity = JOINT_DOUBLE_LEN;
-	
 	rclc_executor_spin(&executor);
 
 	RCCHECK(rcl_subscription_fini(&joint_states_subscriber, &node));
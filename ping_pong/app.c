@@ -4,6 +4,7 @@
 #include <rclc/executor.h>
 
 #include <std_msgs/msg/header.h>
+#include <std_msgs/msg/u_int32_multi_array.h>
 
 #include <stdio.h>
 #include <unistd.h>
@@ -14,8 +15,29 @@
 #include "freertos/task.h"
 #endif
 
+#include "../common/latency_histogram.h"
+#include "../common/ping_window.h"
+#include "../common/pong_suppressor.h"
+#include "../common/executor_loop.h"
+
 #define STRING_BUFFER_LEN 50
 
+// Ping period; lower it together with PING_WINDOW_SIZE for load tests
+#define PING_PERIOD_MS 2000
+
+// Pong answering mode, see pong_suppressor.h. In PONG_MODE_BACKOFF each device
+// waits up to PONG_BACKOFF_MAX_MS and stays silent once PONG_QUORUM peers
+// have answered the same ping.
+#define PONG_MODE PONG_MODE_ALWAYS
+#define PONG_QUORUM 1
+#define PONG_BACKOFF_MAX_MS 200
+#define PONG_FLUSH_PERIOD_MS 10
+
+// RTT statistics are published once per window as
+// [pongs, p50, p90, p99, max], all latencies in microseconds
+#define STATS_WINDOW_MS 10000
+#define STATS_FIELDS 5
+
 #define RCCHECK(fn) { rcl_ret_t temp_rc = fn; if((temp_rc != RCL_RET_OK)){printf("Failed status on line %d: %d. Aborting.\n",__LINE__,(int)temp_rc); vTaskDelete(NULL);}}
 #define RCSOFTCHECK(fn) { rcl_ret_t temp_rc = fn; if((temp_rc != RCL_RET_OK)){printf("Failed status on line %d: %d. Continuing.\n",__LINE__,(int)temp_rc);}}
 
@@ -23,14 +45,27 @@ rcl_publisher_t ping_publisher;
 rcl_publisher_t pong_publisher;
 rcl_subscription_t ping_subscriber;
 rcl_subscription_t pong_subscriber;
+rcl_publisher_t stats_publisher;
 
 std_msgs__msg__Header incoming_ping;
 std_msgs__msg__Header outcoming_ping;
 std_msgs__msg__Header incoming_pong;
+std_msgs__msg__Header outcoming_pong;
+std_msgs__msg__UInt32MultiArray outcoming_stats;
+
+uint32_t device_id;
+ping_window_t ping_window;
+pong_suppressor_t pong_suppressor;
+
+latency_histogram_t rtt_histogram;
+uint32_t stats_buffer[STATS_FIELDS];
 
-int device_id;
-int seq_no;
-int pong_count;
+int64_t monotonic_us(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
 
 void ping_timer_callback(rcl_timer_t * timer, int64_t last_call_time)
 {
@@ -38,9 +73,10 @@ void ping_timer_callback(rcl_timer_t * timer, int64_t last_call_time)
 
 	if (timer != NULL) {
 
-		seq_no = rand();
-		sprintf(outcoming_ping.frame_id.data, "%d_%d", seq_no, device_id);
-		outcoming_ping.frame_id.size = strlen(outcoming_ping.frame_id.data);
+		// Take the next slot of the window, retiring the oldest ping
+		ping_slot_t * slot = ping_window_open(&ping_window);
+		ping_frame_id_encode(outcoming_ping.frame_id.data, device_id, slot->seq);
+		outcoming_ping.frame_id.size = PING_FRAME_ID_LEN;
 
 		// Fill the message timestamp
 		struct timespec ts;
@@ -48,8 +84,7 @@ void ping_timer_callback(rcl_timer_t * timer, int64_t last_call_time)
 		outcoming_ping.stamp.sec = ts.tv_sec;
 		outcoming_ping.stamp.nanosec = ts.tv_nsec;
 
-		// Reset the pong count and publish the ping message
-		pong_count = 0;
+		// Publish the ping message
 		rcl_publish(&ping_publisher, (const void*)&outcoming_ping, NULL);
 		printf("Ping send seq %s\n", outcoming_ping.frame_id.data);
 	}
@@ -58,22 +93,105 @@ void ping_timer_callback(rcl_timer_t * timer, int64_t last_call_time)
 void ping_subscription_callback(const void * msgin)
 {
 	const std_msgs__msg__Header * msg = (const std_msgs__msg__Header *)msgin;
+	uint32_t sender_id, seq;
+
+	if(!ping_frame_id_decode(msg->frame_id.data, msg->frame_id.size, &sender_id, &seq)){
+		printf("Ping received with seq %s. Answering.\n", msg->frame_id.data);
+		rcl_publish(&pong_publisher, (const void*)msg, NULL);
+		return;
+	}
 
 	// Dont pong my own pings
-	if(strcmp(outcoming_ping.frame_id.data, msg->frame_id.data) != 0){
+	if(sender_id == device_id){
+		return;
+	}
+
+	if(pong_suppressor_on_ping(&pong_suppressor, sender_id, seq, msg->stamp.sec, msg->stamp.nanosec, monotonic_us())){
 		printf("Ping received with seq %s. Answering.\n", msg->frame_id.data);
 		rcl_publish(&pong_publisher, (const void*)msg, NULL);
 	}
 }
 
+void pong_flush_timer_callback(rcl_timer_t * timer, int64_t last_call_time)
+{
+	RCLC_UNUSED(last_call_time);
+
+	if (timer != NULL) {
+		const pong_pending_t * due;
+		int64_t now = monotonic_us();
+		while((due = pong_suppressor_next_due(&pong_suppressor, now)) != NULL){
+			ping_frame_id_encode(outcoming_pong.frame_id.data, due->sender_id, due->seq);
+			outcoming_pong.frame_id.size = PING_FRAME_ID_LEN;
+
+			// Move the echoed stamp by the time the pong was held, so the
+			// pinger's RTT leaves out the backoff
+			int64_t stamp_ns = (int64_t)due->stamp_nanosec + (now - due->received_us) * 1000;
+			outcoming_pong.stamp.sec = due->stamp_sec + (int32_t)(stamp_ns / 1000000000);
+			outcoming_pong.stamp.nanosec = (uint32_t)(stamp_ns % 1000000000);
+
+			printf("Backoff expired for seq %s. Answering.\n", outcoming_pong.frame_id.data);
+			rcl_publish(&pong_publisher, (const void*)&outcoming_pong, NULL);
+		}
+	}
+}
+
 
 void pong_subscription_callback(const void * msgin)
 {
 	const std_msgs__msg__Header * msg = (const std_msgs__msg__Header *)msgin;
+	uint32_t sender_id, seq;
+
+	if(!ping_frame_id_decode(msg->frame_id.data, msg->frame_id.size, &sender_id, &seq)) {
+		return;
+	}
 
-	if(strcmp(outcoming_ping.frame_id.data, msg->frame_id.data) == 0) {
-		pong_count++;
-		printf("Pong for seq %s (%d)\n", msg->frame_id.data, pong_count);
+	// A peer answered somebody else's ping: maybe our own pong is no longer needed
+	if(sender_id != device_id) {
+		pong_suppressor_on_pong(&pong_suppressor, sender_id, seq);
+		return;
+	}
+
+	ping_slot_t * slot = ping_window_match(&ping_window, seq);
+	if(slot != NULL) {
+		slot->pong_count++;
+
+		// The pong echoes our own stamp back, so both ends use the same clock;
+		// a backed-off pong moves it by the time it was held
+		struct timespec ts;
+		clock_gettime(CLOCK_REALTIME, &ts);
+		int64_t rtt_us = ((int64_t)ts.tv_sec - msg->stamp.sec) * 1000000
+			+ ((int64_t)ts.tv_nsec - (int64_t)msg->stamp.nanosec) / 1000;
+		if (rtt_us >= 0) {
+			latency_histogram_record(&rtt_histogram, (uint32_t)rtt_us);
+		}
+
+		printf("Pong for seq %s (%u) rtt %d us\n", msg->frame_id.data, (unsigned int)slot->pong_count, (int)rtt_us);
+	}
+}
+
+void stats_timer_callback(rcl_timer_t * timer, int64_t last_call_time)
+{
+	RCLC_UNUSED(last_call_time);
+
+	if (timer != NULL) {
+		stats_buffer[0] = rtt_histogram.total;
+		stats_buffer[1] = latency_histogram_percentile(&rtt_histogram, 500);
+		stats_buffer[2] = latency_histogram_percentile(&rtt_histogram, 900);
+		stats_buffer[3] = latency_histogram_percentile(&rtt_histogram, 990);
+		stats_buffer[4] = rtt_histogram.max;
+		outcoming_stats.data.size = STATS_FIELDS;
+
+		RCSOFTCHECK(rcl_publish(&stats_publisher, (const void*)&outcoming_stats, NULL));
+		printf("RTT window: %u pongs, p50 %u us, p90 %u us, p99 %u us, max %u us\n",
+			(unsigned int)stats_buffer[0], (unsigned int)stats_buffer[1], (unsigned int)stats_buffer[2],
+			(unsigned int)stats_buffer[3], (unsigned int)stats_buffer[4]);
+		printf("Pings sent %u, unanswered %u, late pongs %u\n",
+			(unsigned int)ping_window.sent, (unsigned int)ping_window.unanswered, (unsigned int)ping_window.late_pongs);
+		printf("Pongs sent %u for %u pings heard, cancelled %u, overflow %u\n",
+			(unsigned int)pong_suppressor.stats.sent, (unsigned int)pong_suppressor.stats.pings,
+			(unsigned int)pong_suppressor.stats.cancelled, (unsigned int)pong_suppressor.stats.overflow);
+
+		latency_histogram_reset(&rtt_histogram);
 	}
 }
 
@@ -106,16 +224,34 @@ void appMain(void *argument)
 	RCCHECK(rclc_subscription_init_best_effort(&pong_subscriber, &node,
 		ROSIDL_GET_MSG_TYPE_SUPPORT(std_msgs, msg, Header), "/microROS/pong"));
 
+	// Create a best effort RTT statistics publisher
+	RCCHECK(rclc_publisher_init_best_effort(&stats_publisher, &node,
+		ROSIDL_GET_MSG_TYPE_SUPPORT(std_msgs, msg, UInt32MultiArray), "/microROS/ping_stats"));
+
 
-	// Create a 3 seconds ping timer timer,
+	// Create the ping timer
 	rcl_timer_t timer;
-	RCCHECK(rclc_timer_init_default(&timer, &support, RCL_MS_TO_NS(2000), ping_timer_callback));
+	RCCHECK(rclc_timer_init_default(&timer, &support, RCL_MS_TO_NS(PING_PERIOD_MS), ping_timer_callback));
+
+	// Create the RTT statistics window timer
+	rcl_timer_t stats_timer;
+	RCCHECK(rclc_timer_init_default(&stats_timer, &support, RCL_MS_TO_NS(STATS_WINDOW_MS), stats_timer_callback));
+
+	// Create the timer that sends pongs whose backoff expired
+	rcl_timer_t pong_flush_timer;
+	if (PONG_MODE == PONG_MODE_BACKOFF) {
+		RCCHECK(rclc_timer_init_default(&pong_flush_timer, &support, RCL_MS_TO_NS(PONG_FLUSH_PERIOD_MS), pong_flush_timer_callback));
+	}
 
 
 	// Create executor
 	rclc_executor_t executor;
-	RCCHECK(rclc_executor_init(&executor, &support.context, 3, &allocator));
+	RCCHECK(rclc_executor_init(&executor, &support.context, 5, &allocator));
 	RCCHECK(rclc_executor_add_timer(&executor, &timer));
+	RCCHECK(rclc_executor_add_timer(&executor, &stats_timer));
+	if (PONG_MODE == PONG_MODE_BACKOFF) {
+		RCCHECK(rclc_executor_add_timer(&executor, &pong_flush_timer));
+	}
 	RCCHECK(rclc_executor_add_subscription(&executor, &ping_subscriber, &incoming_ping,
 		&ping_subscription_callback, ON_NEW_DATA));
 	RCCHECK(rclc_executor_add_subscription(&executor, &pong_subscriber, &incoming_pong,
@@ -134,16 +270,31 @@ void appMain(void *argument)
 	incoming_pong.frame_id.data = incoming_pong_buffer;
 	incoming_pong.frame_id.capacity = STRING_BUFFER_LEN;
 
-	device_id = rand();
+	char outcoming_pong_buffer[STRING_BUFFER_LEN];
+	outcoming_pong.frame_id.data = outcoming_pong_buffer;
+	outcoming_pong.frame_id.capacity = STRING_BUFFER_LEN;
 
-	while(1){
-		rclc_executor_spin_some(&executor, RCL_MS_TO_NS(10));
-		usleep(10000);
-	}
+	// The statistics message only carries data, no layout dimensions
+	outcoming_stats.layout.dim.data = NULL;
+	outcoming_stats.layout.dim.size = 0;
+	outcoming_stats.layout.dim.capacity = 0;
+	outcoming_stats.layout.data_offset = 0;
+	outcoming_stats.data.data = stats_buffer;
+	outcoming_stats.data.size = 0;
+	outcoming_stats.data.capacity = STATS_FIELDS;
+
+	latency_histogram_reset(&rtt_histogram);
+
+	device_id = (uint32_t)rand();
+	ping_window_init(&ping_window, (uint32_t)rand());
+	pong_suppressor_init(&pong_suppressor, PONG_MODE, PONG_QUORUM, PONG_BACKOFF_MAX_MS);
+
+	executor_loop_run(&executor, NULL);
 
 	// Free resources
 	RCCHECK(rcl_publisher_fini(&ping_publisher, &node));
 	RCCHECK(rcl_publisher_fini(&pong_publisher, &node));
+	RCCHECK(rcl_publisher_fini(&stats_publisher, &node));
 	RCCHECK(rcl_subscription_fini(&ping_subscriber, &node));
 	RCCHECK(rcl_subscription_fini(&pong_subscriber, &node));
 	RCCHECK(rcl_node_fini(&node));
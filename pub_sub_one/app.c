@@ -14,6 +14,9 @@
 #include "freertos/task.h"
 #endif
 
+#include "../common/executor_loop.h"
+#include "../common/stream_class.h"
+
 #define RCCHECK(fn) { rcl_ret_t temp_rc = fn; if((temp_rc != RCL_RET_OK)){printf("Failed status on line %d: %d. Aborting.\n",__LINE__,(int)temp_rc); vTaskDelete(NULL);}}
 #define RCSOFTCHECK(fn) { rcl_ret_t temp_rc = fn; if((temp_rc != RCL_RET_OK)){printf("Failed status on line %d: %d. Continuing.\n",__LINE__,(int)temp_rc);}}
 
@@ -51,19 +54,21 @@ void appMain(void *argument)
 	rcl_node_t node;
 	RCCHECK(rclc_node_init_default(&node, "int32_publisher_subscriber_rclc", "", &support));
 
-	// create publisher
-	RCCHECK(rclc_publisher_init_default(
+	// create publisher: periodic data, best-effort stream
+	RCCHECK(stream_class_publisher_init(
 		&publisher,
 		&node,
 		ROSIDL_GET_MSG_TYPE_SUPPORT(std_msgs, msg, Int32),
-		"/test1/ESPtoROS"));
+		"/test1/ESPtoROS",
+		STREAM_CLASS_TELEMETRY));
 
-  	// create subscriber
-	RCCHECK(rclc_subscription_init_default(
+	// create subscriber: commands, reliable stream
+	RCCHECK(stream_class_subscription_init(
 		&subscriber,
 		&node,
 		ROSIDL_GET_MSG_TYPE_SUPPORT(std_msgs, msg, Int32),
-		"/test1/ROStoESP"));
+		"/test1/ROStoESP",
+		STREAM_CLASS_CONTROL));
 
 	// create timer,
 	rcl_timer_t timer;
@@ -82,10 +87,7 @@ void appMain(void *argument)
 
 	send_msg.data = 0;
 
-	while(1){
-		rclc_executor_spin_some(&executor, RCL_MS_TO_NS(10));
-		usleep(10000);
-	}
+	executor_loop_run(&executor, NULL);
 
 	// Free resources
 	RCCHECK(rcl_subscription_fini(&subscriber, &node));
@@ -18,7 +18,8 @@
 #include "driver/gpio.h"
 #endif
 
-#define ARRAY_LEN 50
+#include "../common/executor_loop.h"
+#include "../common/message_pool.h"
 
 #define RCCHECK(fn) { rcl_ret_t temp_rc = fn; if((temp_rc != RCL_RET_OK)){printf("Failed status on line %d: %d. Aborting.\n",__LINE__,(int)temp_rc);vTaskDelete(NULL);}}
 #define RCSOFTCHECK(fn) { rcl_ret_t temp_rc = fn; if((temp_rc != RCL_RET_OK)){printf("Failed status on line %d: %d. Continuing.\n",__LINE__,(int)temp_rc);}}
@@ -55,7 +56,7 @@ void button_task(void *arg)
         led_status = !led_status;
         gpio_set_level(BLINK_GPIO, led_status);
 
-        sprintf(msg.data.data, "Hello from ESP32 #%d", counter++);
+        snprintf(msg.data.data, msg.data.capacity, "Hello from ESP32 #%d", counter++);
 		msg.data.size = strlen(msg.data.data);
 		RCSOFTCHECK(rcl_publish(&publisher, &msg, NULL));
 		printf("I have publish: \"%s\"\n", msg.data.data);
@@ -120,16 +121,14 @@ void appMain(void * arg)
 	RCCHECK(rclc_executor_init(&executor, &support.context, 1, &allocator));
 	RCCHECK(rclc_executor_set_trigger(&executor, rclc_executor_trigger_any, &ISR));
 
-	// Fill the array with a known sequence
-	msg.data.data = (char * ) malloc(ARRAY_LEN * sizeof(char));
-	msg.data.size = 0;
-	msg.data.capacity = ARRAY_LEN;
+	// Take the string buffer from the static message pool
+	if (!message_pool_acquire_string(&msg.data)) {
+		printf("Message pool exhausted. Aborting.\n");
+		vTaskDelete(NULL);
+	}
 
 	//rclc_executor_spin(&executor);
-	while(1){
-		rclc_executor_spin_some(&executor, RCL_MS_TO_NS(100));
-		usleep(100000);
-	}
+	executor_loop_run(&executor, NULL);
 
 	// free resources
 	RCCHECK(rcl_publisher_fini(&publisher, &node))
@@ -13,7 +13,9 @@
 #include "freertos/task.h"
 #endif
 
-#define ARRAY_LEN 10
+#include "../common/executor_loop.h"
+#include "../common/pool_allocator.h"
+#include "../common/message_pool.h"
 
 #define RCCHECK(fn) { rcl_ret_t temp_rc = fn; if((temp_rc != RCL_RET_OK)){printf("Failed status on line %d: %d. Aborting.\n",__LINE__,(int)temp_rc);vTaskDelete(NULL);}}
 #define RCSOFTCHECK(fn) { rcl_ret_t temp_rc = fn; if((temp_rc != RCL_RET_OK)){printf("Failed status on line %d: %d. Continuing.\n",__LINE__,(int)temp_rc);}}
@@ -27,7 +29,7 @@ void timer_callback(rcl_timer_t * timer, int64_t last_call_time)
 {
 	RCLC_UNUSED(last_call_time);
 	if (timer != NULL) {
-		sprintf(msg.data.data, "Hello from ESP32 #%d", counter++);
+		snprintf(msg.data.data, msg.data.capacity, "Hello from ESP32 #%d", counter++);
 		msg.data.size = strlen(msg.data.data);
 		RCSOFTCHECK(rcl_publish(&publisher, &msg, NULL));
 		printf("I have publish: \"%s\"\n", msg.data.data);
@@ -36,6 +38,13 @@ void timer_callback(rcl_timer_t * timer, int64_t last_call_time)
 
 void appMain(void * arg)
 {
+	// Serve every micro-ROS allocation from the static pool allocator
+	if (!pool_allocator_install()) {
+		printf("Error on default allocators (line %d)\n",__LINE__);
+		vTaskDelete(NULL);
+	}
+	pool_allocator_set_tag(POOL_TAG_RMW);
+
 	rcl_allocator_t allocator = rcl_get_default_allocator();
 	rclc_support_t support;
 
@@ -43,6 +52,7 @@ void appMain(void * arg)
 	RCCHECK(rclc_support_init(&support, 0, NULL, &allocator));
 
 	// create node
+	pool_allocator_set_tag(POOL_TAG_NODE);
 	rcl_node_t node;
 	RCCHECK(rclc_node_init_default(
 		&node, 
@@ -68,20 +78,22 @@ void appMain(void * arg)
 
 	// create executor
 	//rclc_executor_t executor;
+	rcl_allocator_t executor_allocator = pool_allocator_get(POOL_TAG_EXECUTOR);
 	rclc_executor_t executor = rclc_executor_get_zero_initialized_executor();
-	RCCHECK(rclc_executor_init(&executor, &support.context, 1, &allocator));
+	RCCHECK(rclc_executor_init(&executor, &support.context, 1, &executor_allocator));
 	RCCHECK(rclc_executor_add_timer(&executor, &timer));
 
-	// Fill the array with a known sequence
-	msg.data.data = (char * ) malloc(ARRAY_LEN * sizeof(char));
-	msg.data.size = 0;
-	msg.data.capacity = ARRAY_LEN;
-
-	while(1){
-		rclc_executor_spin_some(&executor, RCL_MS_TO_NS(100));
-		usleep(100000);
+	// Take the string buffer from the static message pool
+	if (!message_pool_acquire_string(&msg.data)) {
+		printf("Message pool exhausted. Aborting.\n");
+		vTaskDelete(NULL);
 	}
 
+	pool_allocator_set_tag(POOL_TAG_OTHER);
+	pool_allocator_print_stats();
+
+	executor_loop_run(&executor, NULL);
+
 	// free resources
 	RCCHECK(rcl_publisher_fini(&publisher, &node))
 	RCCHECK(rcl_node_fini(&node))
@@ -14,6 +14,10 @@
 #include "freertos/task.h"
 #endif
 
+#include "../common/executor_loop.h"
+#include "../common/pool_allocator.h"
+#include "../common/subscription_drain.h"
+
 #define ARRAY_LEN 10
 
 #define RCCHECK(fn) { rcl_ret_t temp_rc = fn; if((temp_rc != RCL_RET_OK)){printf("Failed status on line %d: %d. Aborting.\n",__LINE__,(int)temp_rc);vTaskDelete(NULL);}}
@@ -33,13 +37,21 @@ void appMain(void * arg)
 {
 	memset(test_array,'z',ARRAY_LEN);
 
-  	rcl_allocator_t allocator = rcl_get_default_allocator();
+	// Serve every micro-ROS allocation from the static pool allocator
+	if (!pool_allocator_install()) {
+		printf("Error on default allocators (line %d)\n",__LINE__);
+		vTaskDelete(NULL);
+	}
+	pool_allocator_set_tag(POOL_TAG_RMW);
+
+	rcl_allocator_t allocator = rcl_get_default_allocator();
 	rclc_support_t support;
 
 	// create init_options
 	RCCHECK(rclc_support_init(&support, 0, NULL, &allocator));
 
 	// create node
+	pool_allocator_set_tag(POOL_TAG_NODE);
 	rcl_node_t node;
 	RCCHECK(rclc_node_init_default(&node, "esp32_sub", "", &support));
 
@@ -52,18 +64,26 @@ void appMain(void * arg)
 
 	// create executor
 	//rclc_executor_t executor;
+	rcl_allocator_t executor_allocator = pool_allocator_get(POOL_TAG_EXECUTOR);
 	rclc_executor_t executor = rclc_executor_get_zero_initialized_executor();
-	RCCHECK(rclc_executor_init(&executor, &support.context, 1, &allocator));
-	RCCHECK(rclc_executor_add_subscription(&executor, &subscriber, &msg, &subscription_callback, ON_NEW_DATA));
-
-	msg.data.data = (char * ) malloc(ARRAY_LEN * sizeof(char));
+	RCCHECK(rclc_executor_init(&executor, &support.context, 1, &executor_allocator));
+	// take every queued sample in one spin, not just the first one; the
+	// queue is RMW_UXRCE_MAX_HISTORY=4 deep, set in app-colcon.meta
+	RCCHECK(subscription_drain_add(&executor, &subscriber, &msg, &subscription_callback));
+
+	rcl_allocator_t msg_allocator = pool_allocator_get(POOL_TAG_MESSAGES);
+	msg.data.data = (char * ) msg_allocator.allocate(ARRAY_LEN * sizeof(char), msg_allocator.state);
+	if (msg.data.data == NULL) {
+		printf("Failed to allocate the message buffer. Aborting.\n");
+		vTaskDelete(NULL);
+	}
 	msg.data.size = 0;
 	msg.data.capacity = ARRAY_LEN;
 
-	while(1){
-			rclc_executor_spin_some(&executor, RCL_MS_TO_NS(100));
-			usleep(100000);
-	}
+	pool_allocator_set_tag(POOL_TAG_OTHER);
+	pool_allocator_print_stats();
+
+	executor_loop_run(&executor, NULL);
 
 	// free resources
 	RCCHECK(rcl_subscription_fini(&subscriber, &node));
@@ -0,0 +1,111 @@
+#include <rcl/rcl.h>
+#include <rcl/error_handling.h>
+#include <rclc/rclc.h>
+#include <rclc/executor.h>
+
+#include <std_msgs/msg/int16_multi_array.h>
+#include <geometry_msgs/msg/polygon_stamped.h>
+
+#include <stdio.h>
+
+#ifdef ESP_PLATFORM
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#endif
+
+#include "../common/executor_loop.h"
+#include "../common/telemetry_quant.h"
+#include "../common/crazyflie_telemetry.h"
+
+// Host side of the quantized Crazyflie telemetry: takes the int16 frames
+// from TELEMETRY_QUANT_TOPIC and republishes them as float PolygonStamped
+// frames on CRAZYFLIE_TELEMETRY_TOPIC, so consumers see the same topic and
+// layout whichever encoding the drone uses. The frame sequence number is
+// passed on, so drops are counted the same way too. Must be built with the
+// same TELEMETRY_QUANT_*_SCALE values as the drone.
+
+#define RCCHECK(fn) { rcl_ret_t temp_rc = fn; if((temp_rc != RCL_RET_OK)){printf("Failed status on line %d: %d. Aborting.\n",__LINE__,(int)temp_rc);vTaskDelete(NULL);}}
+#define RCSOFTCHECK(fn) { rcl_ret_t temp_rc = fn; if((temp_rc != RCL_RET_OK)){printf("Failed status on line %d: %d. Continuing.\n",__LINE__,(int)temp_rc);}}
+
+rcl_subscription_t subscriber;
+rcl_publisher_t publisher;
+
+std_msgs__msg__Int16MultiArray incoming_frame;
+int16_t incoming_buffer[TELEMETRY_QUANT_MAX_FIELDS];
+crazyflie_telemetry_t outcoming_frame;
+
+uint32_t decoded;
+uint32_t malformed;
+
+void subscription_callback(const void * msgin)
+{
+	const std_msgs__msg__Int16MultiArray * msg = (const std_msgs__msg__Int16MultiArray *)msgin;
+
+	uint32_t time_ms;
+	uint32_t seq;
+	float pose[6];
+	float weather[2];
+	bool has_weather;
+
+	if (!telemetry_quant_decode(msg->data.data, msg->data.size, &time_ms, &seq, pose, weather, &has_weather)) {
+		malformed++;
+		return;
+	}
+
+	crazyflie_telemetry_stamp(&outcoming_frame, time_ms);
+	crazyflie_telemetry_set_seq(&outcoming_frame, seq);
+	crazyflie_telemetry_set_attitude(&outcoming_frame, pose[0], pose[1], pose[2]);
+	crazyflie_telemetry_set_position(&outcoming_frame, pose[3], pose[4], pose[5]);
+	if (has_weather) {
+		crazyflie_telemetry_set_weather(&outcoming_frame, weather[0], weather[1]);
+	} else {
+		crazyflie_telemetry_clear_weather(&outcoming_frame);
+	}
+
+	RCSOFTCHECK(rcl_publish(&publisher, (const void*)&outcoming_frame.msg, NULL));
+	decoded++;
+}
+
+void appMain(void * arg)
+{
+	rcl_allocator_t allocator = rcl_get_default_allocator();
+	rclc_support_t support;
+
+	// create init_options
+	RCCHECK(rclc_support_init(&support, 0, NULL, &allocator));
+
+	// create node
+	rcl_node_t node;
+	RCCHECK(rclc_node_init_default(&node, "telemetry_decoder", "", &support));
+
+	// create subscriber for the quantized frames and publisher for the decoded ones
+	RCCHECK(rclc_subscription_init_best_effort(&subscriber, &node,
+		ROSIDL_GET_MSG_TYPE_SUPPORT(std_msgs, msg, Int16MultiArray), TELEMETRY_QUANT_TOPIC));
+	RCCHECK(rclc_publisher_init_best_effort(&publisher, &node,
+		ROSIDL_GET_MSG_TYPE_SUPPORT(geometry_msgs, msg, PolygonStamped), CRAZYFLIE_TELEMETRY_TOPIC));
+
+	// create executor
+	rclc_executor_t executor = rclc_executor_get_zero_initialized_executor();
+	RCCHECK(rclc_executor_init(&executor, &support.context, 1, &allocator));
+	RCCHECK(rclc_executor_add_subscription(&executor, &subscriber, &incoming_frame, &subscription_callback, ON_NEW_DATA));
+
+	// Fill the message memory statically
+	incoming_frame.layout.dim.data = NULL;
+	incoming_frame.layout.dim.size = 0;
+	incoming_frame.layout.dim.capacity = 0;
+	incoming_frame.layout.data_offset = 0;
+	incoming_frame.data.data = incoming_buffer;
+	incoming_frame.data.size = 0;
+	incoming_frame.data.capacity = TELEMETRY_QUANT_MAX_FIELDS;
+
+	crazyflie_telemetry_init(&outcoming_frame);
+
+	executor_loop_run(&executor, NULL);
+
+	// free resources
+	RCCHECK(rcl_publisher_fini(&publisher, &node));
+	RCCHECK(rcl_subscription_fini(&subscriber, &node));
+	RCCHECK(rcl_node_fini(&node));
+
+	vTaskDelete(NULL);
+}
@@ -24,6 +24,8 @@
 #include "freertos/task.h"
 #endif
 
+#include "../common/executor_loop.h"
+
 //Check for error
 #define RCCHECK(fn) { rcl_ret_t temp_rc = fn; if((temp_rc != RCL_RET_OK)){printf("Failed status on line %d: %d. Aborting.\n",__LINE__,(int)temp_rc);vTaskDelete(NULL);}}
 #define RCSOFTCHECK(fn) { rcl_ret_t temp_rc = fn; if((temp_rc != RCL_RET_OK)){printf("Failed status on line %d: %d. Continuing.\n",__LINE__,(int)temp_rc);}}
@@ -119,12 +121,7 @@ void appMain(void * arg)
 		ON_NEW_DATA)); //Selects the execution semantics of the spin-method
 	RCCHECK(rclc_executor_add_timer(&executor, &my_timer));
 
-	while(1){
-		for (unsigned int i = 0; i < 10; i++) {
-		rclc_executor_spin_some(&executor, RCL_MS_TO_NS(1000));
-		}
-		usleep(100000);
-	}
+	executor_loop_run(&executor, NULL);
 
 	// clean up
 	RCCHECK(rclc_executor_fini(&executor));
@@ -2,6 +2,9 @@
 
 #define STRING_BUFFER_LEN 50
 
+// Ping period; lower it together with PING_WINDOW_SIZE for load tests
+#define PING_PERIOD_MS 2000
+
 rcl_publisher_t ping_publisher;
 rcl_publisher_t pong_publisher;
 rcl_subscription_t ping_subscriber;
@@ -11,9 +14,8 @@ std_msgs__msg__Header incoming_ping;
 std_msgs__msg__Header outcoming_ping;
 std_msgs__msg__Header incoming_pong;
 
-int device_id;
-int seq_no;
-int pong_count;
+uint32_t device_id;
+ping_window_t ping_window;
 
 void ping_timer_callback(rcl_timer_t * timer, int64_t last_call_time)
 {
@@ -21,9 +23,10 @@ void ping_timer_callback(rcl_timer_t * timer, int64_t last_call_time)
 
 	if (timer != NULL) {
 
-		seq_no = rand();
-		sprintf(outcoming_ping.frame_id.data, "%d_%d", seq_no, device_id);
-		outcoming_ping.frame_id.size = strlen(outcoming_ping.frame_id.data);
+		// Take the next slot of the window, retiring the oldest ping
+		ping_slot_t * slot = ping_window_open(&ping_window);
+		ping_frame_id_encode(outcoming_ping.frame_id.data, device_id, slot->seq);
+		outcoming_ping.frame_id.size = PING_FRAME_ID_LEN;
 
 		// Fill the message timestamp
 		struct timespec ts;
@@ -31,8 +34,7 @@ void ping_timer_callback(rcl_timer_t * timer, int64_t last_call_time)
 		outcoming_ping.stamp.sec = ts.tv_sec;
 		outcoming_ping.stamp.nanosec = ts.tv_nsec;
 
-		// Reset the pong count and publish the ping message
-		pong_count = 0;
+		// Publish the ping message
 		rcl_publish(&ping_publisher, (const void*)&outcoming_ping, NULL);
 		printf("Ping send seq %s\n", outcoming_ping.frame_id.data);
 	}
@@ -41,9 +43,10 @@ void ping_timer_callback(rcl_timer_t * timer, int64_t last_call_time)
 void ping_subscription_callback(const void * msgin)
 {
 	const std_msgs__msg__Header * msg = (const std_msgs__msg__Header *)msgin;
+	uint32_t sender_id, seq;
 
 	// Dont pong my own pings
-	if(strcmp(outcoming_ping.frame_id.data, msg->frame_id.data) != 0){
+	if(!ping_frame_id_decode(msg->frame_id.data, msg->frame_id.size, &sender_id, &seq) || sender_id != device_id){
 		printf("Ping received with seq %s. Answering.\n", msg->frame_id.data);
 		rcl_publish(&pong_publisher, (const void*)msg, NULL);
 	}
@@ -53,10 +56,16 @@ void ping_subscription_callback(const void * msgin)
 void pong_subscription_callback(const void * msgin)
 {
 	const std_msgs__msg__Header * msg = (const std_msgs__msg__Header *)msgin;
+	uint32_t sender_id, seq;
+
+	if(!ping_frame_id_decode(msg->frame_id.data, msg->frame_id.size, &sender_id, &seq) || sender_id != device_id) {
+		return;
+	}
 
-	if(strcmp(outcoming_ping.frame_id.data, msg->frame_id.data) == 0) {
-		pong_count++;
-		printf("Pong for seq %s (%d)\n", msg->frame_id.data, pong_count);
+	ping_slot_t * slot = ping_window_match(&ping_window, seq);
+	if(slot != NULL) {
+		slot->pong_count++;
+		printf("Pong for seq %s (%u)\n", msg->frame_id.data, (unsigned int)slot->pong_count);
 	}
 }
 
@@ -90,9 +99,9 @@ void appMain(void *argument)
 		ROSIDL_GET_MSG_TYPE_SUPPORT(std_msgs, msg, Header), "/microROS/pong"));
 
 
-	// Create a 3 seconds ping timer timer,
+	// Create the ping timer
 	rcl_timer_t timer;
-	RCCHECK(rclc_timer_init_default(&timer, &support, RCL_MS_TO_NS(2000), ping_timer_callback));
+	RCCHECK(rclc_timer_init_default(&timer, &support, RCL_MS_TO_NS(PING_PERIOD_MS), ping_timer_callback));
 
 
 	// Create executor
@@ -117,12 +126,10 @@ void appMain(void *argument)
 	incoming_pong.frame_id.data = incoming_pong_buffer;
 	incoming_pong.frame_id.capacity = STRING_BUFFER_LEN;
 
-	device_id = rand();
+	device_id = (uint32_t)rand();
+	ping_window_init(&ping_window, (uint32_t)rand());
 
-	while(1){
-		rclc_executor_spin_some(&executor, RCL_MS_TO_NS(10));
-		usleep(10000);
-	}
+	executor_loop_run(&executor, NULL);
 
 	// Free resources
 	RCCHECK(rcl_publisher_fini(&ping_publisher, &node));
@@ -8,10 +8,7 @@ void appMain(void * arg)
 
 	init_pub(pubParam);
 
-	while(1){
-		rclc_executor_spin_some(&pubParam->executor, RCL_MS_TO_NS(100));
-		usleep(100000);
-	}
+	executor_loop_run(&pubParam->executor, NULL);
 
 	// free resources
 	RCCHECK(rcl_publisher_fini(&pubParam->publisher, &pubParam->node)) //Destroy publisher
@@ -13,6 +13,8 @@
 #include "freertos/task.h"
 #endif
 
+#include "../common/executor_loop.h"
+
 #define RCCHECK(fn) { rcl_ret_t temp_rc = fn; if((temp_rc != RCL_RET_OK)){printf("Failed status on line %d: %d. Aborting.\n",__LINE__,(int)temp_rc); return 1;}}
 #define RCSOFTCHECK(fn) { rcl_ret_t temp_rc = fn; if((temp_rc != RCL_RET_OK)){printf("Failed status on line %d: %d. Continuing.\n",__LINE__,(int)temp_rc);}}
 
@@ -55,10 +57,7 @@ void appMain(void * arg)
   RCCHECK(rcl_send_request(&client, &req, &seq))
   printf("Send service request %d + %d. Seq %d\n", (int) req.a, (int) req.b, (int) seq);
   
-  while(1){
-		rclc_executor_spin_some(&executor, RCL_MS_TO_NS(100));
-		usleep(100000);
-	}
+  executor_loop_run(&executor, NULL);
 
   RCCHECK(rcl_client_fini(&client, &node));
   RCCHECK(rcl_node_fini(&node));
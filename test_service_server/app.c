@@ -13,6 +13,8 @@
 #include "freertos/task.h"
 #endif
 
+#include "../common/executor_loop.h"
+
 #define RCCHECK(fn) { rcl_ret_t temp_rc = fn; if((temp_rc != RCL_RET_OK)){printf("Failed status on line %d: %d. Aborting.\n",__LINE__,(int)temp_rc);}}
 #define RCSOFTCHECK(fn) { rcl_ret_t temp_rc = fn; if((temp_rc != RCL_RET_OK)){printf("Failed status on line %d: %d. Continuing.\n",__LINE__,(int)temp_rc);}}
 
@@ -49,10 +51,7 @@ void appMain(void * arg)
     example_interfaces__srv__AddTwoInts_Request req;
     RCCHECK(rclc_executor_add_service(&executor, &service, &req, &res, service_callback));
 
-    while(1){
-      rclc_executor_spin_some(&executor, RCL_MS_TO_NS(100));
-      usleep(100000);
-    }
+    executor_loop_run(&executor, NULL);
 
     RCCHECK(rcl_service_fini(&service, &node));
     RCCHECK(rcl_node_fini(&node));
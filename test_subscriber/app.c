@@ -7,6 +7,8 @@
 
 #include <stdio.h>
 
+#include "../common/executor_loop.h"
+
 #define RCCHECK(fn) { rcl_ret_t temp_rc = fn; if((temp_rc != RCL_RET_OK)){printf("Failed status on line %d: %d. Aborting.\n",__LINE__,(int)temp_rc);vTaskDelete(NULL);}}
 #define RCSOFTCHECK(fn) { rcl_ret_t temp_rc = fn; if((temp_rc != RCL_RET_OK)){printf("Failed status on line %d: %d. Continuing.\n",__LINE__,(int)temp_rc);}}
 
@@ -49,11 +51,8 @@ void appMain(void * arg)
 	//to receive incoming publications once its spinning
 	RCCHECK(rclc_executor_add_subscription(&executor, &subscriber, &msg, &subscription_callback, ON_NEW_DATA));
 
-	while(1){
-		// Spin executor to receive messages
-		rclc_executor_spin_some(&executor, RCL_MS_TO_NS(100));
-		usleep(100000);
-	}
+	// Spin executor to receive messages
+	executor_loop_run(&executor, NULL);
 
 	// free resources
 	RCCHECK(rcl_subscription_fini(&subscriber, &node)); //Destroy subscriber
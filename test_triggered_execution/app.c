@@ -5,6 +5,7 @@
 #include <rcl/error_handling.h>
 #include <std_msgs/msg/int32.h>
 #include <std_msgs/msg/string.h>
+#include <std_msgs/msg/u_int32_multi_array.h>
 
 #include <rclc/rclc.h>
 #include <rclc/executor.h>
@@ -14,6 +15,27 @@
 #include "freertos/task.h"
 #endif
 
+#include "../common/message_pool.h"
+#include "../common/memory_monitor.h"
+#include "../common/executor_scheduler.h"
+
+// Memory diagnostics period; a leak shows up as a falling heap_free trend
+#define MEMORY_PERIOD_MS 1000
+
+// The publishing executor runs above the subscribing one, both above appMain,
+// which only prints the scheduler statistics every REPORT_PERIOD_S. The
+// scheduler's dispatcher runs one above the publishing executor.
+#ifdef INC_FREERTOS_H
+#define EXECUTOR_PUB_PRIORITY 7
+#define EXECUTOR_SUB_PRIORITY 6
+#else
+#define EXECUTOR_PUB_PRIORITY 20
+#define EXECUTOR_SUB_PRIORITY 10
+#endif
+#define EXECUTOR_PUB_DEADLINE_MS 10
+#define EXECUTOR_SUB_DEADLINE_MS 50
+#define REPORT_PERIOD_S 5
+
 //Check for error
 #define RCCHECK(fn) { rcl_ret_t temp_rc = fn; if((temp_rc != RCL_RET_OK)){printf("Failed status on line %d: %d. Aborting.\n",__LINE__,(int)temp_rc);vTaskDelete(NULL);}}
 #define RCSOFTCHECK(fn) { rcl_ret_t temp_rc = fn; if((temp_rc != RCL_RET_OK)){printf("Failed status on line %d: %d. Continuing.\n",__LINE__,(int)temp_rc);}}
@@ -25,6 +47,10 @@ std_msgs__msg__Int32 pub_int_msg;
 int pub_int_value;
 std_msgs__msg__Int32 int_sub_msg;
 int pub_string_value;
+rcl_publisher_t my_memory_pub;
+std_msgs__msg__UInt32MultiArray memory_msg;
+memory_monitor_t memory_monitor;
+executor_scheduler_t scheduler;
 
 //Custom-defined trigger conditions. rclc_executor_trigger_any would also be possible
 typedef struct
@@ -121,21 +147,42 @@ void my_int_subscriber_callback(const void * msgin)
 
 #define UNUSED(x) (void)x;
 
+void my_timer_memory_callback(rcl_timer_t * timer, int64_t last_call_time)
+{
+  rcl_ret_t rc;
+  UNUSED(last_call_time);
+  if (timer != NULL) {
+    memory_monitor_sample(&memory_monitor);
+    memory_msg.data.size = memory_monitor.field_count;
+    RCSOFTCHECK(rcl_publish(&my_memory_pub, &memory_msg, NULL));
+    printf("Memory: heap free %u (min %u), allocator %u (peak %u), pool peak %u\n",
+      (unsigned int)memory_monitor.fields[MEMORY_MONITOR_HEAP_FREE],
+      (unsigned int)memory_monitor.fields[MEMORY_MONITOR_HEAP_MIN_FREE],
+      (unsigned int)memory_monitor.fields[MEMORY_MONITOR_ALLOC_USED],
+      (unsigned int)memory_monitor.fields[MEMORY_MONITOR_ALLOC_PEAK],
+      (unsigned int)memory_monitor.fields[MEMORY_MONITOR_POOL_PEAK]);
+  } else {
+    printf("Error in my_timer_memory_callback: timer parameter is NULL\n");
+  }
+}
+
 void my_timer_string_callback(rcl_timer_t * timer, int64_t last_call_time)
 {
   rcl_ret_t rc;
   UNUSED(last_call_time);
   if (timer != NULL) {
     //printf("Timer: time since last call %d\n", (int) last_call_time);
+    // rcl_publish serializes synchronously, so the block goes back right after
     std_msgs__msg__String pub_msg;
-    std_msgs__msg__String__init(&pub_msg);
-    const unsigned int PUB_MSG_CAPACITY = 20;
-    pub_msg.data.data = malloc(PUB_MSG_CAPACITY);
-    pub_msg.data.capacity = PUB_MSG_CAPACITY;
+    if (!message_pool_acquire_string(&pub_msg.data)) {
+      printf("Error in my_timer_string_callback: message pool exhausted\n");
+      return;
+    }
     snprintf(pub_msg.data.data, pub_msg.data.capacity, "Hello World!%d", pub_string_value++);
     pub_msg.data.size = strlen(pub_msg.data.data);
 
     RCSOFTCHECK(rcl_publish(&my_string_pub, &pub_msg, NULL));
+    message_pool_release_string(&pub_msg.data);
   } else {
     printf("Error in my_timer_string_callback: timer parameter is NULL\n");
   }
@@ -178,8 +225,8 @@ void appMain(void * arg)
 	RCCHECK(rclc_publisher_init_default(
 		&my_string_pub,
 		&my_node,
-		&my_type_support,
-		&topic_name));
+		my_type_support,
+		topic_name));
 
 	// create timer 1
 	// - publishes 'my_string_pub' every 'timer_timeout' ms
@@ -212,6 +259,29 @@ void appMain(void * arg)
 		timer_int_period, 
 		my_timer_int_callback));
 	
+	// create memory diagnostics publisher and timer
+	RCCHECK(rclc_publisher_init_best_effort(
+		&my_memory_pub,
+		&my_node,
+		ROSIDL_GET_MSG_TYPE_SUPPORT(std_msgs, msg, UInt32MultiArray),
+		"memory"));
+
+	rcl_timer_t my_memory_timer;
+	RCCHECK(rclc_timer_init_default(
+		&my_memory_timer,
+		&support,
+		RCL_MS_TO_NS(MEMORY_PERIOD_MS),
+		my_timer_memory_callback));
+
+	memory_monitor_init(&memory_monitor);
+	memory_msg.layout.dim.data = NULL;
+	memory_msg.layout.dim.size = 0;
+	memory_msg.layout.dim.capacity = 0;
+	memory_msg.layout.data_offset = 0;
+	memory_msg.data.data = memory_monitor.fields;
+	memory_msg.data.size = 0;
+	memory_msg.data.capacity = MEMORY_MONITOR_MAX_FIELDS;
+
 	//Initialize pub msg vars in timer callbacks
 	std_msgs__msg__Int32__init(&pub_int_msg);
 	pub_int_value = 0;
@@ -235,16 +305,14 @@ void appMain(void * arg)
 	rclc_executor_t executor_sub;
 
 	// Executor for publishing messages
-	unsigned int num_handles_pub = 2;
+	unsigned int num_handles_pub = 3;
 	printf("Executor_pub: number of DDS handles: %u\n", num_handles_pub);
 	executor_pub = rclc_executor_get_zero_initialized_executor();
 	rclc_executor_init(&executor_pub, &support.context, num_handles_pub, &allocator);
 
 	RCCHECK(rclc_executor_add_timer(&executor_pub, &my_string_timer));
 	RCCHECK(rclc_executor_add_timer(&executor_pub, &my_int_timer));
-
-	RCCHECK(rclc_executor_add_timer(&executor_pub, &my_string_timer));
-	RCCHECK(rclc_executor_add_timer(&executor_pub, &my_int_timer));
+	RCCHECK(rclc_executor_add_timer(&executor_pub, &my_memory_timer));
 	
 	unsigned int num_handles_sub = 2;
 	printf("Executor_sub: number of DDS handles: %u\n", num_handles_sub);
@@ -266,13 +334,26 @@ void appMain(void * arg)
 	rclc_executor_set_trigger(&executor_pub, rclc_executor_trigger_any, NULL);
 	rclc_executor_set_trigger(&executor_sub, rclc_executor_trigger_all, NULL);
 
+	// Each executor runs its callbacks in its own task, so a long callback of
+	// one never delays the other; one dispatcher task waits for both
+	executor_scheduler_init(&scheduler);
+	executor_scheduler_add(&scheduler, &executor_pub, "executor_pub", EXECUTOR_PUB_PRIORITY, EXECUTOR_PUB_DEADLINE_MS);
+	executor_scheduler_add(&scheduler, &executor_sub, "executor_sub", EXECUTOR_SUB_PRIORITY, EXECUTOR_SUB_DEADLINE_MS);
+	if (!executor_scheduler_start(&scheduler)) {
+		printf("Failed to start the executor tasks. Aborting.\n");
+		vTaskDelete(NULL);
+	}
+#ifdef INC_FREERTOS_H
+	// The stacks that run the callbacks and the session waits
+	for (size_t i = 0; i < scheduler.count; i++) {
+		memory_monitor_add_task(&memory_monitor, scheduler.entries[i].task);
+	}
+	memory_monitor_add_task(&memory_monitor, scheduler.dispatcher);
+#endif
+
 	while(1){
-		for (unsigned int i = 0; i < 100; i++) {
-		// timeout specified in ns                 (here: 1s)
-		rclc_executor_spin_some(&executor_pub, 1000 * (1000 * 1000));
-		usleep(1000); // 1ms
-		rclc_executor_spin_some(&executor_sub, 1000 * (1000 * 1000));
-		}
+		sleep(REPORT_PERIOD_S);
+		executor_scheduler_print(&scheduler);
 	}
 
 	rcl_ret_t rc;
@@ -281,6 +362,8 @@ void appMain(void * arg)
 	rc += rclc_executor_fini(&executor_sub);
 	rc += rcl_publisher_fini(&my_string_pub, &my_node);
 	rc += rcl_publisher_fini(&my_int_pub, &my_node);
+	rc += rcl_publisher_fini(&my_memory_pub, &my_node);
+	rc += rcl_timer_fini(&my_memory_timer);
 	rc += rcl_timer_fini(&my_string_timer);
 	rc += rcl_timer_fini(&my_int_timer);
 	rc += rcl_subscription_fini(&my_string_sub, &my_node);